@@ -0,0 +1,66 @@
+// Package arena provides a region allocator for short-lived byte strings.
+// Memory is carved out of pooled slabs and released all at once by Reset,
+// so the strings built while processing a page leave no garbage behind.
+package arena
+
+import (
+	"packages/src/pool"
+	"unsafe"
+)
+
+const slabsize = 64 << 10
+
+// Arena hands out byte slices and strings backed by slabs. Nothing it
+// returns may be used after Reset. The zero value is ready to use.
+type Arena struct {
+	slabs []*[]byte
+	cur   []byte
+}
+
+// Alloc returns n bytes of arena memory
+func (a *Arena) Alloc(n int) []byte {
+	if cap(a.cur)-len(a.cur) < n {
+		slab := pool.Get(max(slabsize, n))
+		a.slabs = append(a.slabs, slab)
+		a.cur = (*slab)[:0]
+	}
+	start := len(a.cur)
+	a.cur = a.cur[:start+n]
+	return a.cur[start : start+n : start+n]
+}
+
+// String copies the concatenation of parts into the arena and returns it
+// as a string
+func (a *Arena) String(parts ...string) string {
+	n := 0
+	for _, p := range parts {
+		n += len(p)
+	}
+	if n == 0 {
+		return ""
+	}
+	b := a.Alloc(n)[:0]
+	for _, p := range parts {
+		b = append(b, p...)
+	}
+	return unsafe.String(unsafe.SliceData(b), len(b))
+}
+
+// View returns b as a string without copying. The caller guarantees b is
+// arena memory, or otherwise outlives the string and is not modified.
+func View(b []byte) string {
+	if len(b) == 0 {
+		return ""
+	}
+	return unsafe.String(unsafe.SliceData(b), len(b))
+}
+
+// Reset releases every slab at once
+func (a *Arena) Reset() {
+	for _, slab := range a.slabs {
+		pool.Put(slab)
+	}
+	clear(a.slabs)
+	a.slabs = a.slabs[:0]
+	a.cur = nil
+}
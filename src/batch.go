@@ -0,0 +1,158 @@
+package crawler
+
+import (
+	"net/url"
+	"packages/src/arena"
+	"slices"
+	"strings"
+	"sync"
+)
+
+// Batchcache is a Cacheable testing and recording many links of a domain in
+// a single pass, under one lock
+type Batchcache interface {
+	Cacheable
+	// ContainsBatch sets seen[i] when links[i] is recorded for domain
+	ContainsBatch(domain string, links []string, seen []bool)
+	// SetBatch records links for domain, setting seen[i] for the ones
+	// recorded already
+	SetBatch(domain string, links []string, seen []bool)
+}
+
+// checkscratch is the working memory of a CheckBatch call
+type checkscratch struct {
+	keys  []string
+	fresh []string
+	order []int32
+	seen  []bool
+}
+
+var checkscratches = sync.Pool{
+	New: func() any { return new(checkscratch) },
+}
+
+// CheckBatch is Checkin over the links of a page, appending their verdicts
+// to verdicts. The links are ordered by cache key, which groups them by
+// host: the domain test and the robots group lookup happen once per host,
+// and the cache is probed in two passes over the keys, one testing them all
+// and one recording the new ones, each under a single lock when the cache
+// is a Batchcache. A link repeated in the batch is Visited after its first
+// occurrence.
+func (r *Crawlingrules) CheckBatch(links []*url.URL, scratch *arena.Arena, verdicts []Verdict) []Verdict {
+	s := checkscratches.Get().(*checkscratch)
+	defer s.release()
+	start := len(verdicts)
+	verdicts = slices.Grow(verdicts, len(links))[:start+len(links)]
+	out := verdicts[start:]
+
+	for _, l := range links {
+		s.keys = append(s.keys, cachekey(l, scratch))
+	}
+	s.seen = slices.Grow(s.seen[:0], len(links))[:len(links)]
+	containsBatch(r.cache, r.baseKey, s.keys, s.seen)
+	for i, seen := range s.seen {
+		if seen {
+			out[i] = Visited
+		} else {
+			s.order = append(s.order, int32(i))
+		}
+	}
+	slices.SortFunc(s.order, func(a, b int32) int {
+		if c := strings.Compare(s.keys[a], s.keys[b]); c != 0 {
+			return c
+		}
+		return int(a - b)
+	})
+
+	r.rwMutex.RLock()
+	group := r.robotsGroups
+	r.rwMutex.RUnlock()
+	var (
+		host   string
+		onhost bool
+		prev   string
+	)
+	// The links to record overwrite the order already walked
+	record := s.order[:0]
+	for k, i := range s.order {
+		l := links[i]
+		if k > 0 && s.keys[i] == prev {
+			out[i] = Visited
+			continue
+		}
+		prev = s.keys[i]
+		if k == 0 || l.Host != host {
+			host, onhost = l.Host, subdomain(r.baseDomain, l)
+		}
+		switch {
+		case !onhost:
+			out[i] = Offdomain
+		case group != nil && !r.decisions.test(group, l.RequestURI()):
+			out[i] = Robots
+		case r.traps != nil && r.traps.trap(l):
+			out[i] = Trap
+			continue
+		default:
+			out[i] = Accepted
+		}
+		record = append(record, i)
+	}
+
+	for _, i := range record {
+		s.fresh = append(s.fresh, s.keys[i])
+	}
+	seen := s.seen[:len(record)]
+	setBatch(r.cache, r.baseKey, s.fresh, seen)
+	for j, i := range record {
+		// Recorded meanwhile by a check outside the batch
+		if seen[j] {
+			out[i] = Visited
+		}
+	}
+	return verdicts
+}
+
+// AllowedBatch is Allowed over the links of a page. Bit i of the returned
+// mask, grown from mask, is set when links[i] is accepted. Cache keys are
+// built in scratch when it is not nil.
+func (r *Crawlingrules) AllowedBatch(links []*url.URL, scratch *arena.Arena, mask []uint64) []uint64 {
+	mask = slices.Grow(mask[:0], (len(links)+63)/64)[:(len(links)+63)/64]
+	clear(mask)
+	var buf [64]Verdict
+	verdicts := r.CheckBatch(links, scratch, buf[:0])
+	for i, v := range verdicts {
+		if v == Accepted {
+			mask[i/64] |= 1 << (i % 64)
+		}
+	}
+	return mask
+}
+
+func (s *checkscratch) release() {
+	clear(s.keys)
+	clear(s.fresh)
+	s.keys, s.fresh, s.order = s.keys[:0], s.fresh[:0], s.order[:0]
+	checkscratches.Put(s)
+}
+
+func containsBatch(cache Cacheable, domain string, links []string, seen []bool) {
+	if batch, ok := cache.(Batchcache); ok {
+		batch.ContainsBatch(domain, links, seen)
+		return
+	}
+	for i, link := range links {
+		seen[i] = cache.Contains(domain, link)
+	}
+}
+
+func setBatch(cache Cacheable, domain string, links []string, seen []bool) {
+	if batch, ok := cache.(Batchcache); ok {
+		batch.SetBatch(domain, links, seen)
+		return
+	}
+	for i, link := range links {
+		if seen[i] = cache.Contains(domain, link); !seen[i] {
+			cache.Set(domain, link)
+		}
+	}
+}
@@ -0,0 +1,104 @@
+package crawler
+
+import (
+	"fmt"
+	"net/url"
+	"packages/src/arena"
+	"strings"
+	"testing"
+)
+
+func checkrules(t *testing.T) *Crawlingrules {
+	t.Helper()
+	robots := "User-agent: *\nDisallow: /private\nAllow: /private/ok\nDisallow: /*.pdf$\n"
+	group, _ := ParseRobots(strings.NewReader(robots), "crawler")
+	r := NewCrawlingRules(mustURL(t, "http://example.com/"), NewMemorycache(), 0)
+	r.SetRobotsGroup(group)
+	// Only the limits of a single URL, the others depend on the order the
+	// links are checked in
+	r.SetTraplimits(Traplimits{PathDepth: 6, Repeats: 2})
+	r.Allowed(mustURL(t, "http://example.com/seen"))
+	return r
+}
+
+func TestCheckBatchMatchesAllowed(t *testing.T) {
+	links := []string{
+		"http://example.com/a",
+		"http://example.com/seen",
+		"http://example.com/private/x",
+		"http://example.com/private/ok/y",
+		"http://example.com/doc.pdf",
+		"http://example.com/doc.pdf?download=1",
+		"http://other.com/a",
+		"http://example.com/b?q=1",
+		"http://example.com/a",
+		"http://example.com/1/2/3/4/5/6/7",
+		"http://example.com/x/x/x",
+		"http://other.com/a",
+		"http://example.com/b?q=2",
+		"http://example.com/caf%C3%A9",
+		"http://example.com/b?q=1",
+		"http://Example.com/upper",
+	}
+	var urls []*url.URL
+	for _, l := range links {
+		urls = append(urls, mustURL(t, l))
+	}
+
+	one, batch := checkrules(t), checkrules(t)
+	var scratch arena.Arena
+	verdicts := batch.CheckBatch(urls, &scratch, []Verdict{Accepted})
+	if len(verdicts) != len(urls)+1 || verdicts[0] != Accepted {
+		t.Fatalf("CheckBatch returned %d verdicts, want the first kept and %d more", len(verdicts), len(urls))
+	}
+	verdicts = verdicts[1:]
+	for i, u := range urls {
+		want := one.Check(u)
+		if verdicts[i] != want {
+			t.Errorf("CheckBatch(%s) = %v, Check = %v", u, verdicts[i], want)
+		}
+	}
+
+	// Both recorded the same links as visited
+	for _, u := range urls {
+		if a, b := one.Allowed(u), batch.Allowed(u); a != b {
+			t.Errorf("Allowed(%s) after checking = %v and %v", u, a, b)
+		}
+	}
+
+	mask := checkrules(t).AllowedBatch(urls, nil, nil)
+	again := checkrules(t)
+	for i, u := range urls {
+		if got, want := mask[i/64]&(1<<(i%64)) != 0, again.Allowed(u); got != want {
+			t.Errorf("AllowedBatch bit of %s = %v, Allowed = %v", u, got, want)
+		}
+	}
+}
+
+func BenchmarkCheckBatch(b *testing.B) {
+	urls := make([]*url.URL, 64)
+	for i := range urls {
+		host := "example.com"
+		if i%8 == 7 {
+			host = "other.com"
+		}
+		urls[i] = mustURL(b, fmt.Sprintf("http://%s/section/%d/page?n=%d", host, i%5, i))
+	}
+	// Every other link is repeated, the rest are new to the cache
+	urls = append(urls, urls[:32]...)
+	group, _ := ParseRobots(strings.NewReader("User-agent: *\nDisallow: /section/3\nAllow: /section/3/page\n"), "crawler")
+	var (
+		scratch  arena.Arena
+		verdicts []Verdict
+	)
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		// Fresh rules, so the links are checked rather than found visited
+		b.StopTimer()
+		r := NewCrawlingRules(mustURL(b, "http://example.com/"), NewMemorycache(), 0)
+		r.SetRobotsGroup(group)
+		scratch.Reset()
+		b.StartTimer()
+		verdicts = r.CheckBatch(urls, &scratch, verdicts[:0])
+	}
+}
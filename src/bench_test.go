@@ -0,0 +1,35 @@
+package crawler
+
+import (
+	"fmt"
+	"net/url"
+	"testing"
+)
+
+func mustURL(t testing.TB, link string) *url.URL {
+	t.Helper()
+	u, err := url.Parse(link)
+	if err != nil {
+		t.Fatal(err)
+	}
+	return u
+}
+
+func BenchmarkFrontier(b *testing.B) {
+	const hosts = 64
+	links := make([]*url.URL, 1024)
+	for i := range links {
+		links[i] = mustURL(b, fmt.Sprintf("http://host%d.com/page/%d", i%hosts, i))
+	}
+	f := NewFrontier(4)
+	b.ReportAllocs()
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		f.Pushbatch(links[i%len(links):i%len(links)+1], i%4)
+		e, ok := f.Pop()
+		if !ok {
+			b.Fatal("Pop returned false")
+		}
+		f.Done(e)
+	}
+}
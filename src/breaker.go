@@ -0,0 +1,82 @@
+package crawler
+
+import (
+	"packages/src/fetcher"
+	"time"
+)
+
+// Breakerlimits configure the circuit breaker guarding each host. After
+// Failures transient failures in a row the breaker opens and the host is
+// parked in the frontier for Cooldown, so workers stop spending their time
+// on its timeouts. The fetch following the pause is a trial: a success
+// closes the breaker, a failure parks the host again for twice as long, up
+// to MaxCooldown. Once Trials trials in a row have failed, the URLs queued
+// for the host are dropped so a dead host does not hold the crawl open.
+type Breakerlimits struct {
+	Failures    int
+	Cooldown    time.Duration
+	MaxCooldown time.Duration
+	Trials      int // zero never drops
+}
+
+// DefaultBreakerlimits opens after 5 failures for 10s, backing off to 5m,
+// and gives up on a host after 3 failed trials
+func DefaultBreakerlimits() Breakerlimits {
+	return Breakerlimits{Failures: 5, Cooldown: 10 * time.Second, MaxCooldown: 5 * time.Minute, Trials: 3}
+}
+
+// SetBreakers guards every host with a circuit breaker configured by limits
+func (c *Crawler) SetBreakers(limits Breakerlimits) {
+	c.breakers = &limits
+}
+
+// breaker tracks the failures of a host. It is only touched by the worker
+// the frontier handed the host to.
+type breaker struct {
+	failures int
+	trials   int           // failed trials since the breaker opened
+	cooldown time.Duration // zero while closed
+}
+
+// record counts the outcome of a fetch and returns how long the host must
+// be parked, zero when it may go on being fetched, and whether to give up
+// on its queued URLs
+func (b *breaker) record(failed bool, limits Breakerlimits) (time.Duration, bool) {
+	if !failed {
+		*b = breaker{}
+		return 0, false
+	}
+	b.failures++
+	switch {
+	case b.cooldown > 0:
+		b.trials++
+		b.cooldown = min(2*b.cooldown, limits.MaxCooldown)
+	case b.failures >= limits.Failures:
+		b.cooldown = limits.Cooldown
+	default:
+		return 0, false
+	}
+	return b.cooldown, limits.Trials > 0 && b.trials >= limits.Trials
+}
+
+// guard records the outcome of a fetch of host, parking it when its breaker
+// opens. It reports whether it gave up on the host and dropped its URLs.
+func (c *Crawler) guard(host *hoststate, name string, err error) bool {
+	if c.breakers == nil {
+		return false
+	}
+	park, giveup := host.breaker.record(fetcher.Transient(err), *c.breakers)
+	if park == 0 {
+		return false
+	}
+	c.metrics.parked.Inc()
+	c.frontier.Park(name, park)
+	if giveup {
+		dropped := c.frontier.Extract(func(h string) bool { return h != name })
+		for _, e := range dropped {
+			c.checkpoints.complete(e.URL)
+		}
+		c.metrics.abandoned.Add(uint64(len(dropped)))
+	}
+	return giveup
+}
@@ -0,0 +1,275 @@
+package crawler
+
+import (
+	"math"
+	"net/url"
+	"time"
+)
+
+const (
+	defaulttop  = 64 // entries ranked per host
+	promotescan = 64 // entries of the buckets of a host ranked again per Rerank
+)
+
+// Budget allots the fetches of each host to its most valuable pages. The
+// value of a queued page grows with the links found to it and with how
+// recently its sitemap says it changed, and falls with its depth. The Top
+// most valuable entries of a host wait in a heap and are handed out first,
+// the others wait in depth order and take the place of the ones handed out.
+// Once a host has been handed Pages entries, plus PerInlink for every link
+// from another host to it, the rest of its entries are dropped.
+type Budget struct {
+	Pages     int     // entries handed out per host, unlimited when zero
+	PerInlink float64 // extra entries per link from another host
+	Top       int     // entries ranked per host, 64 when zero
+}
+
+// SetBudget ranks the entries of each host by value and caps the fetches
+// of each host. It must be called before the crawl starts.
+func (c *Crawler) SetBudget(b Budget) {
+	c.frontier.SetBudget(b)
+}
+
+// SetBudget ranks the entries of the hosts queued from then on
+func (f *Frontier) SetBudget(b Budget) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	if b.Top <= 0 {
+		b.Top = defaulttop
+	}
+	f.budget = &b
+}
+
+// ranked is an entry waiting in the heap of its host
+type ranked struct {
+	entry    Entry
+	inlinks  int32
+	priority float32 // given by the priority function of the frontier
+	value    float32
+}
+
+// rate sets the value of r: a point per doubling of its in-links and of its
+// priority, half a point off per level of depth, and up to two points when
+// its sitemap says it changed within the last days
+func (r *ranked) rate(now time.Time) {
+	v := math.Log2(1+float64(r.inlinks)) + math.Log2(1+float64(r.priority)) - 0.5*float64(r.entry.Depth)
+	if m := r.entry.Modified; !m.IsZero() {
+		v += 2 / (1 + max(now.Sub(m).Hours()/24, 0))
+	}
+	r.value = float32(v)
+}
+
+// rank queues e in the heap of h when it is among its most valuable
+// entries. It returns the entry left for the buckets, if any.
+func (h *hostqueue) rank(e Entry, limit int) (Entry, bool) {
+	if e.key == "" {
+		e.key = cachekey(e.URL, nil)
+	}
+	r := ranked{entry: e}
+	if h.priority != nil {
+		r.priority = float32(h.priority(e.key))
+	}
+	r.rate(time.Now())
+	if len(h.top) >= limit {
+		i := h.weakest()
+		if h.top[i].value >= r.value {
+			return e, true
+		}
+		weakest := h.remove(i)
+		h.insert(r)
+		return weakest.entry, true
+	}
+	h.insert(r)
+	return Entry{}, false
+}
+
+func (h *hostqueue) insert(r ranked) {
+	if h.ranks == nil {
+		h.ranks = make(map[string]int32)
+	}
+	h.top = append(h.top, r)
+	h.ranks[r.entry.key] = int32(len(h.top) - 1)
+	h.up(len(h.top) - 1)
+}
+
+// remove takes the entry at i out of the heap
+func (h *hostqueue) remove(i int) ranked {
+	r := h.top[i]
+	last := len(h.top) - 1
+	h.swap(i, last)
+	h.top[last] = ranked{}
+	h.top = h.top[:last]
+	delete(h.ranks, r.entry.key)
+	if i < last {
+		h.fix(i)
+	}
+	return r
+}
+
+// weakest returns the index of the least valuable entry, one of the leaves
+func (h *hostqueue) weakest() int {
+	w := len(h.top) / 2
+	for i := w + 1; i < len(h.top); i++ {
+		if h.top[i].value < h.top[w].value {
+			w = i
+		}
+	}
+	return w
+}
+
+func (h *hostqueue) fix(i int) {
+	if !h.down(i) {
+		h.up(i)
+	}
+}
+
+func (h *hostqueue) up(i int) {
+	for i > 0 {
+		parent := (i - 1) / 2
+		if h.top[parent].value >= h.top[i].value {
+			return
+		}
+		h.swap(i, parent)
+		i = parent
+	}
+}
+
+// down sinks the entry at i, reporting whether it moved
+func (h *hostqueue) down(i int) bool {
+	start := i
+	for {
+		child := 2*i + 1
+		if child >= len(h.top) {
+			break
+		}
+		if right := child + 1; right < len(h.top) && h.top[right].value > h.top[child].value {
+			child = right
+		}
+		if h.top[i].value >= h.top[child].value {
+			break
+		}
+		h.swap(i, child)
+		i = child
+	}
+	return i > start
+}
+
+func (h *hostqueue) swap(i, j int) {
+	h.top[i], h.top[j] = h.top[j], h.top[i]
+	h.ranks[h.top[i].entry.key] = int32(i)
+	h.ranks[h.top[j].entry.key] = int32(j)
+}
+
+// Cite records the links of a page of host from, keys being their cache
+// keys. Each raises the value of the entry it points to while the entry is
+// ranked, and the links to other hosts raise their budget.
+func (f *Frontier) Cite(from string, links []*url.URL, keys []string) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	if f.budget == nil {
+		return
+	}
+	now := time.Now()
+	for i, l := range links {
+		h, ok := f.hosts[l.Host]
+		if !ok {
+			continue
+		}
+		if l.Host != from {
+			h.cited++
+		}
+		if j, ok := h.ranks[keys[i]]; ok {
+			r := &h.top[j]
+			r.inlinks++
+			r.rate(now)
+			h.up(int(j))
+		}
+	}
+}
+
+// Overbudget reports whether the host of e, just popped, was handed out
+// more entries than its budget allows
+func (f *Frontier) Overbudget(e Entry) bool {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	b := f.budget
+	if b == nil || b.Pages <= 0 {
+		return false
+	}
+	h := f.hosts[e.URL.Host]
+	return float64(h.handed) > float64(b.Pages)+b.PerInlink*float64(h.cited)
+}
+
+// SetPriority raises the value of the entries ranked from then on by
+// priority, called with their cache key. It must be set before the hosts
+// are queued.
+func (f *Frontier) SetPriority(priority func(key string) float64) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	f.priority = priority
+}
+
+// Rerank rates the entries ranked again with their current priority, and
+// ranks up to promotescan of the entries waiting in the buckets of each
+// host, so that those whose priority rose take the place of the weakest.
+// Successive calls go through the buckets in turn. The frontier is locked
+// one host at a time.
+func (f *Frontier) Rerank() {
+	f.mutex.Lock()
+	if f.priority == nil {
+		f.mutex.Unlock()
+		return
+	}
+	hosts := make([]*hostqueue, 0, len(f.hosts))
+	for _, h := range f.hosts {
+		if len(h.top) > 0 && h.priority != nil {
+			hosts = append(hosts, h)
+		}
+	}
+	f.mutex.Unlock()
+
+	now := time.Now()
+	for _, h := range hosts {
+		f.mutex.Lock()
+		for i := range h.top {
+			r := &h.top[i]
+			r.priority = float32(h.priority(r.entry.key))
+			r.rate(now)
+		}
+		for i := len(h.top)/2 - 1; i >= 0; i-- {
+			h.down(i)
+		}
+		h.promote()
+		f.mutex.Unlock()
+	}
+}
+
+// promote ranks the next promotescan entries of the buckets, putting back
+// those left out at the tail of their bucket. The bucket promoted and the
+// entries of it already ranked are kept for the next call.
+func (h *hostqueue) promote() {
+	for scan, tried := promotescan, 0; scan > 0 && tried <= len(h.buckets); tried++ {
+		if h.promoting < h.lowest || h.promoting >= len(h.buckets) {
+			h.promoting, h.promoted = h.lowest, 0
+		}
+		q := &h.buckets[h.promoting]
+		n := min(q.len()-h.promoted, scan)
+		for i := 0; i < n; i++ {
+			if e, left := h.rank(q.pop(), h.limit); left {
+				h.buckets[e.Depth].push(e)
+				h.lowest = min(h.lowest, e.Depth)
+			}
+		}
+		scan -= max(n, 0)
+		if h.promoted += max(n, 0); h.promoted >= q.len() {
+			h.promoting, h.promoted = h.promoting+1, 0
+		}
+	}
+}
+
+// ranking reports whether the frontier ranks entries by value
+func (f *Frontier) ranking() bool {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	return f.budget != nil
+}
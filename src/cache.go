@@ -0,0 +1,68 @@
+package crawler
+
+import (
+	"strings"
+	"sync"
+)
+
+// Memorycache is an in-memory Cacheable keeping the visited URLs of each domain
+type Memorycache struct {
+	entries map[string]map[string]struct{}
+	rwMutex sync.RWMutex
+}
+
+// NewMemorycache creates a new Memorycache struct
+func NewMemorycache() *Memorycache {
+	return &Memorycache{
+		entries: make(map[string]map[string]struct{}),
+	}
+}
+
+func (m *Memorycache) Set(domain, link string) {
+	m.rwMutex.Lock()
+	defer m.rwMutex.Unlock()
+
+	links, ok := m.entries[domain]
+	if !ok {
+		links = make(map[string]struct{})
+		m.entries[strings.Clone(domain)] = links
+	}
+	links[strings.Clone(link)] = struct{}{}
+}
+
+func (m *Memorycache) Contains(domain, link string) bool {
+	m.rwMutex.RLock()
+	defer m.rwMutex.RUnlock()
+
+	_, ok := m.entries[domain][link]
+	return ok
+}
+
+// ContainsBatch is Contains over links, taking the lock once
+func (m *Memorycache) ContainsBatch(domain string, links []string, seen []bool) {
+	m.rwMutex.RLock()
+	defer m.rwMutex.RUnlock()
+
+	recorded := m.entries[domain]
+	for i, link := range links {
+		_, seen[i] = recorded[link]
+	}
+}
+
+// SetBatch is Set over links, taking the lock once. seen[i] is set for the
+// links recorded already.
+func (m *Memorycache) SetBatch(domain string, links []string, seen []bool) {
+	m.rwMutex.Lock()
+	defer m.rwMutex.Unlock()
+
+	recorded, ok := m.entries[domain]
+	if !ok {
+		recorded = make(map[string]struct{}, len(links))
+		m.entries[strings.Clone(domain)] = recorded
+	}
+	for i, link := range links {
+		if _, seen[i] = recorded[link]; !seen[i] {
+			recorded[strings.Clone(link)] = struct{}{}
+		}
+	}
+}
@@ -0,0 +1,951 @@
+package crawler
+
+import (
+	"bufio"
+	"bytes"
+	"compress/flate"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"net/url"
+	"os"
+	"packages/src/arena"
+	"packages/src/fetcher"
+	"path/filepath"
+	"slices"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+const (
+	checkpointchunk  = 1 << 20 // raw bytes of records per compressed section
+	checkpointdeltas = 8       // deltas written before they are merged into a new base
+	checkpointmagic  = "crawlck2"
+)
+
+var errCorruptCheckpoint = errors.New("crawler: corrupt checkpoint")
+
+// Kinds of the records of a checkpoint
+const (
+	recordVisited = iota // domain and link set in the visited cache
+	recordQueued         // depth and plain flag, discovery and modification times and link of a frontier entry
+	recordDone           // link of an entry fetched or given up on
+	recordRobots         // host and the robots.txt group applying to it
+	recordDelay          // schedule key and the end of its running crawl delay
+	numRecords
+)
+
+// Outcomes of checkpoints
+const (
+	checkpointSaved = iota
+	checkpointFailed
+	checkpointCompacted
+	numCheckpointOutcomes
+)
+
+var checkpointOutcomes = [numCheckpointOutcomes]string{"saved", "failed", "compacted"}
+
+// Restored counts the state of an earlier crawl loaded from its checkpoints
+type Restored struct {
+	Visited int // links recorded in the visited cache
+	Queued  int // entries put back in the frontier
+	Hosts   int // hosts whose robots.txt is not fetched again
+	Elapsed time.Duration
+}
+
+// SetCheckpoint saves the state of the crawl under dir every interval, and
+// once more when Crawl returns: the visited links, the frontier, the
+// robots.txt rules of each host and the crawl delays still running. Workers
+// are not paused: they journal their changes in memory, and a checkpoint
+// swaps the journal for an empty one and writes it to a delta file in the
+// background. Every few checkpoints the deltas are merged into a new base
+// file, leaving out the entries fetched since.
+//
+// When dir holds the checkpoints of an earlier crawl, its state is loaded
+// first and Crawl resumes it, fetching again the entries that were in
+// flight. It must be called before Crawl, after SetSpill so restored
+// entries may spill. A zero interval only saves the last checkpoint.
+func (c *Crawler) SetCheckpoint(dir string, interval time.Duration) (Restored, error) {
+	if err := os.MkdirAll(dir, 0o755); err != nil {
+		return Restored{}, err
+	}
+	p, err := openCheckpointer(dir, interval)
+	if err != nil {
+		return Restored{}, err
+	}
+	restored, err := c.restore(p)
+	if err != nil {
+		return restored, err
+	}
+	c.checkpoints = p
+	c.cache = &journaledcache{Cacheable: c.cache, journal: p}
+	return restored, nil
+}
+
+// checkpointer journals the changes to the state of a crawl and saves them
+// under dir. The files are a base, holding the state at some point, and the
+// deltas written after it, each holding the changes journaled between two
+// checkpoints. Files are written under a temporary name and renamed once
+// synced, so a crash never leaves a partial one.
+type checkpointer struct {
+	dir      string
+	interval time.Duration
+	files    []string // the base then the deltas, oldest first
+	sequence int      // of the last file written
+	next     int      // sequence of the delta the journal becomes
+	unsaved  []delta  // deltas whose write failed, oldest first
+	deflate  *flate.Writer
+	robots   map[string]*Group // robots.txt groups of the hosts restored
+	wal      *writelog
+
+	// Workers hold consistent for reading while journaling changes that
+	// must land in the same checkpoint, such as the links queued from a
+	// page and the page being done
+	consistent sync.RWMutex
+	mutex      sync.Mutex
+	pending    [numRecords][][]byte
+}
+
+func openCheckpointer(dir string, interval time.Duration) (*checkpointer, error) {
+	entries, err := os.ReadDir(dir)
+	if err != nil {
+		return nil, err
+	}
+	base := -1
+	var deltas, logs []int
+	for _, e := range entries {
+		name := e.Name()
+		if strings.HasSuffix(name, ".tmp") {
+			os.Remove(filepath.Join(dir, name))
+			continue
+		}
+		if seq, ok := checkpointSequence(name, "base-"); ok {
+			base = max(base, seq)
+		} else if seq, ok := checkpointSequence(name, "delta-"); ok {
+			deltas = append(deltas, seq)
+		} else if seq, ok := walSequence(name); ok {
+			logs = append(logs, seq)
+		}
+	}
+	deflate, _ := flate.NewWriter(nil, flate.BestSpeed)
+	p := &checkpointer{dir: dir, interval: interval, deflate: deflate, robots: make(map[string]*Group)}
+	if base >= 0 {
+		p.files, p.sequence = append(p.files, checkpointName("base-", base)), base
+	}
+	slices.Sort(deltas)
+	for _, seq := range deltas {
+		if seq <= base {
+			// Merged into the base by a compaction cut short
+			os.Remove(filepath.Join(dir, checkpointName("delta-", seq)))
+			continue
+		}
+		p.files, p.sequence = append(p.files, checkpointName("delta-", seq)), seq
+	}
+	for _, e := range entries {
+		if seq, ok := checkpointSequence(e.Name(), "base-"); ok && seq < base {
+			os.Remove(filepath.Join(dir, e.Name()))
+		}
+	}
+
+	// The logs of the checkpoints never saved become their deltas
+	slices.Sort(logs)
+	for _, seq := range logs {
+		path := filepath.Join(dir, walName(seq))
+		if seq > p.sequence {
+			records, err := replay(path)
+			if err != nil {
+				return nil, err
+			}
+			if d := (delta{sequence: seq, records: records}); !d.empty() {
+				name := checkpointName("delta-", seq)
+				if err := p.write(name, d.emit); err != nil {
+					return nil, err
+				}
+				p.files, p.sequence = append(p.files, name), seq
+			}
+		}
+		os.Remove(path)
+	}
+	p.next = p.sequence + 1
+	return p, nil
+}
+
+func checkpointName(prefix string, sequence int) string {
+	return fmt.Sprintf("%s%08d.ckpt", prefix, sequence)
+}
+
+func checkpointSequence(name, prefix string) (int, bool) {
+	name, ok := strings.CutPrefix(name, prefix)
+	if !ok {
+		return 0, false
+	}
+	if name, ok = strings.CutSuffix(name, ".ckpt"); !ok {
+		return 0, false
+	}
+	seq, err := strconv.Atoi(name)
+	return seq, err == nil
+}
+
+// begin and end enclose changes that must land in the same checkpoint
+func (p *checkpointer) begin() {
+	if p != nil {
+		p.consistent.RLock()
+	}
+}
+
+func (p *checkpointer) end() {
+	if p != nil {
+		p.consistent.RUnlock()
+	}
+}
+
+// chunk returns the journal chunk the next record of kind is appended to.
+// It is called with the mutex held.
+func (p *checkpointer) chunk(kind int) *[]byte {
+	chunks := p.pending[kind]
+	if len(chunks) == 0 || len(chunks[len(chunks)-1]) >= checkpointchunk {
+		p.pending[kind] = append(chunks, make([]byte, 0, 4096))
+	}
+	return &p.pending[kind][len(p.pending[kind])-1]
+}
+
+// visit journals links set in the visited cache of domain, but for those
+// whose seen is true. A nil seen journals them all.
+func (p *checkpointer) visit(domain string, links []string, seen []bool) {
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	for i, link := range links {
+		if seen == nil || !seen[i] {
+			b := p.chunk(recordVisited)
+			start := len(*b)
+			*b = appendString(appendString(*b, domain), link)
+			p.logged(recordVisited, *b, start)
+		}
+	}
+}
+
+// enqueue journals link queued in the frontier at depth
+func (p *checkpointer) enqueue(link *url.URL, depth int) {
+	if p == nil {
+		return
+	}
+	now := time.Now().UnixNano()
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	p.queued(link, depth, now, 0)
+}
+
+// enqueueBatch journals links queued in the frontier at depth, modified[i]
+// being the last change of links[i] when modified is not nil
+func (p *checkpointer) enqueueBatch(links []*url.URL, modified []time.Time, depth int) {
+	if p == nil {
+		return
+	}
+	now := time.Now().UnixNano()
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	for i, link := range links {
+		var changed int64
+		if modified != nil {
+			changed = unixNano(modified[i])
+		}
+		p.queued(link, depth, now, changed)
+	}
+}
+
+// queued journals an entry, modified being zero when its last change is
+// unknown
+func (p *checkpointer) queued(link *url.URL, depth int, discovered, modified int64) {
+	b := p.chunk(recordQueued)
+	start := len(*b)
+	// Plain links are restored without url.Parse
+	flags := uint64(depth) << 1
+	if fetcher.Plainurl(link) {
+		flags |= 1
+	}
+	*b = binary.AppendUvarint(*b, flags)
+	*b = binary.AppendVarint(*b, discovered)
+	*b = binary.AppendVarint(*b, modified)
+	*b = appendURL(*b, link)
+	p.logged(recordQueued, *b, start)
+}
+
+// complete journals that link needs no fetch after a restart
+func (p *checkpointer) complete(link *url.URL) {
+	if p == nil {
+		return
+	}
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	b := p.chunk(recordDone)
+	start := len(*b)
+	*b = appendURL(*b, link)
+	p.logged(recordDone, *b, start)
+}
+
+// fetchedRobots journals the robots.txt group applying to host, nil when
+// none does
+func (p *checkpointer) fetchedRobots(host string, g *Group) {
+	if p == nil {
+		return
+	}
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	b := p.chunk(recordRobots)
+	start := len(*b)
+	defer func() { p.logged(recordRobots, *b, start) }()
+	*b = appendString(*b, host)
+	if g == nil {
+		*b = append(*b, 0)
+		return
+	}
+	*b = append(*b, 1)
+	*b = appendString(*b, g.agent)
+	*b = binary.AppendVarint(*b, int64(g.crawlDelay))
+	*b = binary.AppendUvarint(*b, uint64(len(g.rules)))
+	for _, r := range g.rules {
+		allow := byte(0)
+		if r.allow {
+			allow = 1
+		}
+		*b = appendString(append(*b, allow), r.path)
+	}
+}
+
+// logged passes the record of kind appended to b from start to the
+// write-ahead log. It is called with the mutex held.
+func (p *checkpointer) logged(kind int, b []byte, start int) {
+	if p.wal != nil {
+		p.wal.log(kind, b[start:])
+	}
+}
+
+// position returns the position of the write-ahead log after the records
+// journaled so far
+func (p *checkpointer) position() uint64 {
+	p.mutex.Lock()
+	defer p.mutex.Unlock()
+	return p.wal.lsn
+}
+
+// delta holds the changes journaled between two checkpoints
+type delta struct {
+	sequence int
+	records  [numRecords][][]byte
+	lsn      uint64 // position of the write-ahead log at its end
+}
+
+func (d *delta) empty() bool {
+	for _, chunks := range d.records {
+		if len(chunks) > 0 {
+			return false
+		}
+	}
+	return true
+}
+
+func (d *delta) emit(w *sectionwriter) error {
+	for kind, chunks := range d.records {
+		for _, raw := range chunks {
+			if err := w.section(kind, raw); err != nil {
+				return err
+			}
+		}
+	}
+	return nil
+}
+
+// save swaps the journal for an empty one and writes it to a new delta,
+// along with delays, the delay records of the running crawl delays. It
+// reports whether the deltas were merged into a new base. A delta whose
+// write fails is written again, before the next ones, by the next save.
+func (p *checkpointer) save(delays []byte) (bool, error) {
+	p.consistent.Lock()
+	p.mutex.Lock()
+	d := delta{sequence: p.next, records: p.pending}
+	p.pending = [numRecords][][]byte{}
+	p.next++
+	if p.wal != nil {
+		d.lsn, p.wal.segment = p.wal.lsn, p.next
+	}
+	p.mutex.Unlock()
+	p.consistent.Unlock()
+
+	if len(delays) > 0 {
+		d.records[recordDelay] = append(d.records[recordDelay], delays)
+	}
+	p.unsaved = append(p.unsaved, d)
+	for len(p.unsaved) > 0 {
+		d := &p.unsaved[0]
+		if !d.empty() {
+			name := checkpointName("delta-", d.sequence)
+			if err := p.write(name, d.emit); err != nil {
+				return false, err
+			}
+			p.files, p.sequence = append(p.files, name), d.sequence
+		}
+		if p.wal != nil {
+			p.wal.retire(d.sequence, d.lsn)
+		}
+		p.unsaved[0] = delta{}
+		p.unsaved = p.unsaved[1:]
+	}
+	if len(p.files) <= checkpointdeltas {
+		return false, nil
+	}
+	return true, p.compact()
+}
+
+// compact merges the files into a new base. The visited links and robots
+// groups are copied as they are, the entries done since the base are left
+// out, along with the crawl delays over by now.
+func (p *checkpointer) compact() error {
+	done, err := p.doneset()
+	if err != nil {
+		return err
+	}
+	delays := make(map[string]int64)
+	name := checkpointName("base-", p.sequence)
+	err = p.write(name, func(w *sectionwriter) error {
+		var queued []byte
+		err := p.scan(func(kind int) bool { return kind != recordDone }, func(kind int, s *sectionreader) error {
+			switch kind {
+			case recordVisited, recordRobots:
+				compressed, err := s.compressed()
+				if err != nil {
+					return err
+				}
+				return w.copy(kind, s.rawlen, compressed)
+			case recordDelay:
+				return s.delays(delays)
+			}
+			raw, err := s.records()
+			if err != nil {
+				return err
+			}
+			r := recordreader{raw: raw}
+			for len(r.raw) > 0 && r.err == nil {
+				record := r.raw
+				r.uvarint()
+				r.varint()
+				r.varint()
+				link := r.bytes()
+				if r.err == nil && !done[arena.View(link)] {
+					queued = append(queued, record[:len(record)-len(r.raw)]...)
+				}
+				if len(queued) >= checkpointchunk {
+					if err := w.section(recordQueued, queued); err != nil {
+						return err
+					}
+					queued = queued[:0]
+				}
+			}
+			return r.err
+		})
+		if err != nil {
+			return err
+		}
+		if len(queued) > 0 {
+			if err := w.section(recordQueued, queued); err != nil {
+				return err
+			}
+		}
+		now := time.Now().UnixNano()
+		var raw []byte
+		for key, next := range delays {
+			if next > now {
+				raw = binary.AppendVarint(appendString(raw, key), next)
+			}
+		}
+		if len(raw) > 0 {
+			return w.section(recordDelay, raw)
+		}
+		return nil
+	})
+	if err != nil {
+		return err
+	}
+	for _, f := range p.files {
+		os.Remove(filepath.Join(p.dir, f))
+	}
+	p.files = append(p.files[:0], name)
+	return nil
+}
+
+// doneset returns the links of the done records. Only deltas hold them.
+func (p *checkpointer) doneset() (map[string]bool, error) {
+	done := make(map[string]bool)
+	err := p.scan(func(kind int) bool { return kind == recordDone }, func(_ int, s *sectionreader) error {
+		raw, err := s.records()
+		if err != nil {
+			return err
+		}
+		r := recordreader{raw: raw}
+		for len(r.raw) > 0 && r.err == nil {
+			if link := r.bytes(); r.err == nil {
+				done[string(link)] = true
+			}
+		}
+		return r.err
+	})
+	return done, err
+}
+
+// write creates the file name, holding the sections emit writes
+func (p *checkpointer) write(name string, emit func(*sectionwriter) error) error {
+	path := filepath.Join(p.dir, name)
+	file, err := os.Create(path + ".tmp")
+	if err != nil {
+		return err
+	}
+	w := &sectionwriter{out: bufio.NewWriterSize(file, 1<<16), deflate: p.deflate}
+	w.out.WriteString(checkpointmagic)
+	err = emit(w)
+	if err == nil {
+		err = w.out.Flush()
+	}
+	if err == nil {
+		err = file.Sync()
+	}
+	if cerr := file.Close(); err == nil {
+		err = cerr
+	}
+	if err == nil {
+		err = os.Rename(path+".tmp", path)
+	}
+	if err != nil {
+		os.Remove(path + ".tmp")
+		return err
+	}
+	// Make the rename durable
+	if d, err := os.Open(p.dir); err == nil {
+		d.Sync()
+		d.Close()
+	}
+	return nil
+}
+
+// scan calls f with the sections of the files whose kind is wanted, oldest
+// first. The sections f reads neither the records nor the compressed bytes
+// of are skipped.
+func (p *checkpointer) scan(want func(kind int) bool, f func(kind int, s *sectionreader) error) error {
+	s := &sectionreader{}
+	for _, name := range p.files {
+		file, err := os.Open(filepath.Join(p.dir, name))
+		if err != nil {
+			return err
+		}
+		err = s.reset(file)
+		for err == nil {
+			var kind int
+			if kind, err = s.next(); err == nil && want(kind) {
+				err = f(kind, s)
+			}
+		}
+		file.Close()
+		if err != io.EOF {
+			return err
+		}
+	}
+	return nil
+}
+
+// sectionwriter writes the compressed sections of records of a file
+type sectionwriter struct {
+	out        *bufio.Writer
+	deflate    *flate.Writer
+	compressed bytes.Buffer
+}
+
+func (w *sectionwriter) section(kind int, raw []byte) error {
+	w.compressed.Reset()
+	w.deflate.Reset(&w.compressed)
+	w.deflate.Write(raw)
+	if err := w.deflate.Close(); err != nil {
+		return err
+	}
+	return w.copy(kind, len(raw), w.compressed.Bytes())
+}
+
+// copy writes a section compressed already. Write errors surface when the
+// output is flushed.
+func (w *sectionwriter) copy(kind, rawlen int, compressed []byte) error {
+	header := binary.AppendUvarint([]byte{byte(kind)}, uint64(rawlen))
+	header = binary.AppendUvarint(header, uint64(len(compressed)))
+	w.out.Write(header)
+	w.out.Write(compressed)
+	return nil
+}
+
+// sectionreader reads the sections of a file one at a time
+type sectionreader struct {
+	in      *bufio.Reader
+	inflate io.ReadCloser
+	rawlen  int
+	complen int
+	read    bool // the compressed bytes of the section were read
+	comp    []byte
+	raw     []byte
+}
+
+func (s *sectionreader) reset(file io.Reader) error {
+	if s.in == nil {
+		s.in = bufio.NewReaderSize(file, 1<<16)
+	} else {
+		s.in.Reset(file)
+	}
+	s.read = true
+	var magic [len(checkpointmagic)]byte
+	if _, err := io.ReadFull(s.in, magic[:]); err != nil || string(magic[:]) != checkpointmagic {
+		return errCorruptCheckpoint
+	}
+	return nil
+}
+
+// next moves to the next section and returns its kind, io.EOF after the
+// last one
+func (s *sectionreader) next() (int, error) {
+	if !s.read {
+		if _, err := s.in.Discard(s.complen); err != nil {
+			return 0, errCorruptCheckpoint
+		}
+	}
+	kind, err := s.in.ReadByte()
+	if err != nil {
+		return 0, err
+	}
+	rawlen, err := binary.ReadUvarint(s.in)
+	if err != nil {
+		return 0, errCorruptCheckpoint
+	}
+	complen, err := binary.ReadUvarint(s.in)
+	if err != nil || int(kind) >= numRecords || rawlen > 4*checkpointchunk || complen > 4*checkpointchunk {
+		return 0, errCorruptCheckpoint
+	}
+	s.rawlen, s.complen, s.read = int(rawlen), int(complen), false
+	return int(kind), nil
+}
+
+// compressed returns the compressed bytes of the section
+func (s *sectionreader) compressed() ([]byte, error) {
+	s.comp = slices.Grow(s.comp[:0], s.complen)[:s.complen]
+	s.read = true
+	if _, err := io.ReadFull(s.in, s.comp); err != nil {
+		return nil, errCorruptCheckpoint
+	}
+	return s.comp, nil
+}
+
+// records returns the records of the section, valid until the next call
+func (s *sectionreader) records() ([]byte, error) {
+	compressed, err := s.compressed()
+	if err != nil {
+		return nil, err
+	}
+	if s.inflate == nil {
+		s.inflate = flate.NewReader(bytes.NewReader(compressed))
+	} else {
+		s.inflate.(flate.Resetter).Reset(bytes.NewReader(compressed), nil)
+	}
+	s.raw = slices.Grow(s.raw[:0], s.rawlen)[:s.rawlen]
+	if _, err := io.ReadFull(s.inflate, s.raw); err != nil {
+		return nil, errCorruptCheckpoint
+	}
+	return s.raw, nil
+}
+
+// delays decodes the delay records of the section into delays
+func (s *sectionreader) delays(delays map[string]int64) error {
+	raw, err := s.records()
+	if err != nil {
+		return err
+	}
+	r := recordreader{raw: raw}
+	for len(r.raw) > 0 && r.err == nil {
+		key, next := r.bytes(), r.varint()
+		if r.err == nil {
+			delays[string(key)] = next
+		}
+	}
+	return r.err
+}
+
+// recordreader decodes the fields of records
+type recordreader struct {
+	raw []byte
+	err error
+}
+
+func (r *recordreader) uvarint() uint64 {
+	v, n := binary.Uvarint(r.raw)
+	if n <= 0 {
+		r.fail()
+		return 0
+	}
+	r.raw = r.raw[n:]
+	return v
+}
+
+func (r *recordreader) varint() int64 {
+	v, n := binary.Varint(r.raw)
+	if n <= 0 {
+		r.fail()
+		return 0
+	}
+	r.raw = r.raw[n:]
+	return v
+}
+
+func (r *recordreader) flag() byte {
+	if len(r.raw) == 0 {
+		r.fail()
+		return 0
+	}
+	b := r.raw[0]
+	r.raw = r.raw[1:]
+	return b
+}
+
+func (r *recordreader) bytes() []byte {
+	length := r.uvarint()
+	if uint64(len(r.raw)) < length {
+		r.fail()
+		return nil
+	}
+	b := r.raw[:length]
+	r.raw = r.raw[length:]
+	return b
+}
+
+func (r *recordreader) fail() {
+	r.raw, r.err = nil, errCorruptCheckpoint
+}
+
+func appendString(b []byte, s string) []byte {
+	return append(binary.AppendUvarint(b, uint64(len(s))), s...)
+}
+
+// appendURL is appendString(b, u.String()), without building the string
+// for the plain URLs fetcher.Plainurl accepts
+func appendURL(b []byte, u *url.URL) []byte {
+	if !fetcher.Plainurl(u) {
+		return appendString(b, u.String())
+	}
+	length := len(u.Scheme) + len("://") + len(u.Host) + len(u.Path)
+	if u.RawQuery != "" {
+		length += len("?") + len(u.RawQuery)
+	}
+	b = binary.AppendUvarint(b, uint64(length))
+	b = append(append(append(append(b, u.Scheme...), "://"...), u.Host...), u.Path...)
+	if u.RawQuery != "" {
+		b = append(append(b, '?'), u.RawQuery...)
+	}
+	return b
+}
+
+// plainURL parses link, the serialization of a URL fetcher.Plainurl accepts
+func plainURL(link string) *url.URL {
+	u := &url.URL{}
+	u.Scheme, link, _ = strings.Cut(link, "://")
+	link, u.RawQuery, _ = strings.Cut(link, "?")
+	if i := strings.IndexByte(link, '/'); i >= 0 {
+		u.Host, u.Path = link[:i], link[i:]
+	} else {
+		u.Host = link
+	}
+	return u
+}
+
+// journaledcache journals the links set in a Cacheable
+type journaledcache struct {
+	Cacheable
+	journal *checkpointer
+}
+
+func (j *journaledcache) Set(domain, link string) {
+	j.Cacheable.Set(domain, link)
+	j.journal.visit(domain, []string{link}, nil)
+}
+
+func (j *journaledcache) ContainsBatch(domain string, links []string, seen []bool) {
+	containsBatch(j.Cacheable, domain, links, seen)
+}
+
+func (j *journaledcache) SetBatch(domain string, links []string, seen []bool) {
+	setBatch(j.Cacheable, domain, links, seen)
+	j.journal.visit(domain, links, seen)
+}
+
+// checkpointing saves a checkpoint every interval, and commits the
+// write-ahead log when enabled, until the returned function is called,
+// which saves a last checkpoint and returns its error
+func (c *Crawler) checkpointing() func() error {
+	stop := make(chan struct{})
+	var wg sync.WaitGroup
+	if wal := c.checkpoints.wal; wal != nil {
+		wal.commits, wal.sync = &c.metrics.walCommits, c.metrics.walSync
+		wal.closed, wal.broken, wal.failures = false, false, 0
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			wal.run(c.checkpoints, stop)
+		}()
+	}
+	if interval := c.checkpoints.interval; interval > 0 {
+		wg.Add(1)
+		go func() {
+			defer wg.Done()
+			ticker := time.NewTicker(interval)
+			defer ticker.Stop()
+			for {
+				select {
+				case <-ticker.C:
+					c.checkpoint()
+				case <-stop:
+					return
+				}
+			}
+		}()
+	}
+	return func() error {
+		close(stop)
+		wg.Wait()
+		return c.checkpoint()
+	}
+}
+
+// checkpoint saves the changes journaled since the last checkpoint
+func (c *Crawler) checkpoint() error {
+	compacted, err := c.checkpoints.save(c.delays())
+	switch {
+	case err != nil:
+		c.metrics.checkpoints[checkpointFailed].Inc()
+	case compacted:
+		c.metrics.checkpoints[checkpointCompacted].Inc()
+		fallthrough
+	default:
+		c.metrics.checkpoints[checkpointSaved].Inc()
+	}
+	return err
+}
+
+// delays encodes the crawl delays still running as delay records
+func (c *Crawler) delays() []byte {
+	now := time.Now()
+	var raw []byte
+	c.hostsMutex.Lock()
+	defer c.hostsMutex.Unlock()
+	for key, s := range c.schedules {
+		s.mutex.Lock()
+		next := s.next
+		s.mutex.Unlock()
+		if next.After(now) {
+			raw = binary.AppendVarint(appendString(raw, key), next.UnixNano())
+		}
+	}
+	return raw
+}
+
+// restore loads the state saved by p into the crawler: the links are set
+// in the cache, the entries not done are queued, the robots.txt groups are
+// kept for loadRules and the crawl delays still running are scheduled.
+func (c *Crawler) restore(p *checkpointer) (Restored, error) {
+	start := time.Now()
+	var restored Restored
+	done, err := p.doneset()
+	if err != nil {
+		return restored, err
+	}
+	delays := make(map[string]int64)
+	var (
+		links   []string
+		seen    []bool
+		entries []Entry
+	)
+	err = p.scan(func(kind int) bool { return kind != recordDone }, func(kind int, s *sectionreader) error {
+		if kind == recordDelay {
+			return s.delays(delays)
+		}
+		raw, err := s.records()
+		if err != nil {
+			return err
+		}
+		r := recordreader{raw: raw}
+		switch kind {
+		case recordVisited:
+			// Runs of links of the same domain are set in one batch
+			var domain []byte
+			flush := func() {
+				seen = slices.Grow(seen[:0], len(links))[:len(links)]
+				setBatch(c.cache, arena.View(domain), links, seen)
+				restored.Visited += len(links)
+				clear(links)
+				links = links[:0]
+			}
+			for len(r.raw) > 0 && r.err == nil {
+				d, link := r.bytes(), r.bytes()
+				if !bytes.Equal(d, domain) && len(links) > 0 {
+					flush()
+				}
+				domain = d
+				links = append(links, arena.View(link))
+			}
+			flush()
+		case recordQueued:
+			for len(r.raw) > 0 && r.err == nil {
+				flags, discovered, modified, link := r.uvarint(), r.varint(), r.varint(), r.bytes()
+				if r.err != nil || done[arena.View(link)] {
+					continue
+				}
+				var u *url.URL
+				if flags&1 != 0 {
+					u = plainURL(string(link))
+				} else if u, err = url.Parse(string(link)); err != nil {
+					continue
+				}
+				e := Entry{URL: u, Depth: int(flags >> 1), Discovered: time.Unix(0, discovered)}
+				if modified != 0 {
+					e.Modified = time.Unix(0, modified)
+				}
+				entries = append(entries, e)
+			}
+			restored.Queued += c.frontier.Restore(entries)
+			clear(entries)
+			entries = entries[:0]
+		case recordRobots:
+			for len(r.raw) > 0 && r.err == nil {
+				host, g := string(r.bytes()), r.group()
+				if r.err == nil {
+					p.robots[host] = g
+				}
+			}
+		}
+		return r.err
+	})
+	for key, next := range delays {
+		c.schedules[key] = &schedule{next: time.Unix(0, next)}
+	}
+	restored.Hosts = len(p.robots)
+	restored.Elapsed = time.Since(start)
+	return restored, err
+}
+
+// group decodes the robots.txt group of a robots record
+func (r *recordreader) group() *Group {
+	if r.flag() == 0 {
+		return nil
+	}
+	g := &Group{agent: string(r.bytes()), crawlDelay: time.Duration(r.varint())}
+	n := r.uvarint()
+	for i := uint64(0); i < n && r.err == nil; i++ {
+		allow := r.flag() == 1
+		path := r.bytes()
+		if r.err == nil {
+			g.rules = append(g.rules, newRule(string(path), allow))
+		}
+	}
+	return g
+}
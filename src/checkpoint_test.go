@@ -0,0 +1,131 @@
+package crawler
+
+import (
+	"fmt"
+	"net/url"
+	"packages/src/fetcher"
+	"strings"
+	"testing"
+	"time"
+)
+
+func checkpointed(t *testing.T, dir string) (*Crawler, Restored) {
+	t.Helper()
+	c := NewCrawler(DefaultCrawlersettings(fetcher.Hrefparser{}), nil, NewMemorycache())
+	restored, err := c.SetCheckpoint(dir, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	return c, restored
+}
+
+// queuedLinks pops every entry restored in c, by link
+func queuedLinks(t *testing.T, c *Crawler) map[string]int {
+	t.Helper()
+	links := make(map[string]int)
+	for c.frontier.Len() > 0 {
+		e := pop(t, c.frontier)
+		links[e.URL.String()] = e.Depth
+		c.frontier.Done(e)
+	}
+	return links
+}
+
+func TestCheckpointRoundTrip(t *testing.T) {
+	dir := t.TempDir()
+	p, err := openCheckpointer(dir, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	a, b := mustURL(t, "http://example.com/a"), mustURL(t, "http://example.com/b?q=%20x")
+	p.visit("http://example.com/", []string{a.String(), b.String()}, nil)
+	p.enqueue(a, 1)
+	p.enqueue(b, 2)
+	p.complete(a)
+	group, _ := ParseRobots(strings.NewReader("User-agent: *\nCrawl-delay: 2\nDisallow: /private\n"), "crawler")
+	p.fetchedRobots("example.com", group)
+	p.fetchedRobots("norobots.com", nil)
+	if _, err := p.save(nil); err != nil {
+		t.Fatal(err)
+	}
+
+	c, restored := checkpointed(t, dir)
+	if restored.Visited != 2 || restored.Queued != 1 || restored.Hosts != 2 {
+		t.Errorf("restored %+v, want 2 visited, 1 queued and 2 hosts", restored)
+	}
+	for _, link := range []string{a.String(), b.String()} {
+		if !c.cache.Contains("http://example.com/", link) {
+			t.Errorf("%s not restored as visited", link)
+		}
+	}
+	if links := queuedLinks(t, c); len(links) != 1 || links[b.String()] != 2 {
+		t.Errorf("restored the entries %v, want %s at depth 2", links, b)
+	}
+	g := c.checkpoints.robots["example.com"]
+	if g == nil || g.crawlDelay != group.crawlDelay || g.Test("/private/x") || !g.Test("/public") {
+		t.Errorf("restored the robots group %+v, want %+v", g, group)
+	}
+	if g, ok := c.checkpoints.robots["norobots.com"]; !ok || g != nil {
+		t.Errorf("restored the robots group %+v of a host without any", g)
+	}
+}
+
+func TestCheckpointCompaction(t *testing.T) {
+	dir := t.TempDir()
+	p, err := openCheckpointer(dir, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	// Each checkpoint queues a link and completes the previous one
+	const saves = 2*checkpointdeltas + 3
+	compactions := 0
+	for i := 0; i < saves; i++ {
+		p.enqueue(mustURL(t, fmt.Sprintf("http://example.com/%d", i)), 1)
+		if i > 0 {
+			p.complete(mustURL(t, fmt.Sprintf("http://example.com/%d", i-1)))
+		}
+		compacted, err := p.save(nil)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if compacted {
+			compactions++
+		}
+	}
+	if compactions == 0 || len(p.files) > checkpointdeltas {
+		t.Errorf("%d compactions leaving %d files", compactions, len(p.files))
+	}
+
+	c, restored := checkpointed(t, dir)
+	last := fmt.Sprintf("http://example.com/%d", saves-1)
+	if links := queuedLinks(t, c); restored.Queued != 1 || len(links) != 1 || links[last] != 1 {
+		t.Errorf("restored the entries %v, want %s", links, last)
+	}
+}
+
+func TestCheckpointModified(t *testing.T) {
+	dir := t.TempDir()
+	p, err := openCheckpointer(dir, 0)
+	if err != nil {
+		t.Fatal(err)
+	}
+	lastmod := time.Date(2024, 5, 1, 12, 0, 0, 0, time.UTC)
+	links := []*url.URL{mustURL(t, "http://example.com/new"), mustURL(t, "http://example.com/unknown")}
+	p.enqueueBatch(links, []time.Time{lastmod, {}}, 1)
+	if _, err := p.save(nil); err != nil {
+		t.Fatal(err)
+	}
+
+	c, _ := checkpointed(t, dir)
+	for c.frontier.Len() > 0 {
+		e := pop(t, c.frontier)
+		want := time.Time{}
+		if e.URL.Path == "/new" {
+			want = lastmod
+		}
+		if !e.Modified.Equal(want) || e.Modified.IsZero() != want.IsZero() {
+			t.Errorf("%s restored as modified at %v, want %v", e.URL, e.Modified, want)
+		}
+		c.frontier.Done(e)
+	}
+}
@@ -0,0 +1,274 @@
+package cluster
+
+import (
+	"net"
+	"net/rpc"
+	"net/url"
+	crawler "packages/src"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// Link is a discovered link in transit to the node owning its host
+type Link struct {
+	URL   string
+	Depth int
+}
+
+// Batch is the unit of exchange between nodes. Payload holds Count links
+// compressed by encodeBatch.
+type Batch struct {
+	From    string
+	Count   int
+	Payload []byte
+}
+
+// exchange is the RPC service nodes deliver batches to
+type exchange struct {
+	node *Node
+}
+
+func (e *exchange) Deliver(batch Batch, reply *int) error {
+	links, err := decodeBatch(batch.Payload, batch.Count)
+	e.node.received.Add(uint64(batch.Count))
+	for _, l := range links {
+		link, err := url.Parse(l.URL)
+		if err != nil {
+			continue
+		}
+		e.node.dispatch(link, l.Depth)
+	}
+	*reply = len(links)
+	return err
+}
+
+// Node connects a Crawler to the other nodes of a cluster. It implements
+// crawler.Router: links of hosts owned elsewhere go through an outbox that
+// drops duplicates and delivers them to their owner in compressed batches.
+type Node struct {
+	addr     string
+	crawler  *crawler.Crawler
+	ring     atomic.Pointer[Ring]
+	listener net.Listener
+
+	outbox *outbox
+
+	mutex  sync.Mutex
+	peers  map[string]*rpc.Client
+	conns  map[net.Conn]struct{} // accepted from peers
+	closed bool
+	quit   chan struct{}
+	done   sync.WaitGroup
+
+	sent     atomic.Uint64
+	received atomic.Uint64
+	dropped  atomic.Uint64
+}
+
+// NewNode creates a new Node listening on addr and makes it the router of c.
+// The node starts as the only member of its ring.
+func NewNode(addr string, c *crawler.Crawler, options Options) (*Node, error) {
+	listener, err := net.Listen("tcp", addr)
+	if err != nil {
+		return nil, err
+	}
+	server := rpc.NewServer()
+
+	n := &Node{
+		addr:     listener.Addr().String(),
+		crawler:  c,
+		listener: listener,
+		outbox:   newOutbox(options.withDefaults()),
+		peers:    make(map[string]*rpc.Client),
+		conns:    make(map[net.Conn]struct{}),
+		quit:     make(chan struct{}),
+	}
+	if err := server.RegisterName("Exchange", &exchange{node: n}); err != nil {
+		listener.Close()
+		return nil, err
+	}
+	n.ring.Store(NewRing(defaultreplicas, n.addr))
+	c.SetRouter(n)
+
+	n.done.Add(2)
+	go func() {
+		defer n.done.Done()
+		for {
+			conn, err := listener.Accept()
+			if err != nil {
+				return
+			}
+			if !n.track(conn) {
+				conn.Close()
+				return
+			}
+			n.done.Add(1)
+			go func() {
+				defer n.done.Done()
+				server.ServeConn(conn)
+				n.mutex.Lock()
+				delete(n.conns, conn)
+				n.mutex.Unlock()
+			}()
+		}
+	}()
+	go n.flushLoop()
+	return n, nil
+}
+
+// track records conn as served until Close, unless the node is closed
+func (n *Node) track(conn net.Conn) bool {
+	n.mutex.Lock()
+	defer n.mutex.Unlock()
+	if n.closed {
+		return false
+	}
+	n.conns[conn] = struct{}{}
+	return true
+}
+
+// Addr returns the address the node listens on, which is its name in the ring
+func (n *Node) Addr() string {
+	return n.addr
+}
+
+// SetMembers replaces the ring with one made of nodes, which should include
+// this node. Queued links of hosts that moved are handed to their new owner.
+func (n *Node) SetMembers(nodes []string) {
+	n.ring.Store(NewRing(defaultreplicas, nodes...))
+	for _, e := range n.crawler.Release(n.Owns) {
+		n.Route(e.URL, e.Depth)
+	}
+}
+
+// Owns reports whether the ring assigns host to this node
+func (n *Node) Owns(host string) bool {
+	return n.ring.Load().Owner(host) == n.addr
+}
+
+// Route buffers link for the node owning its host
+func (n *Node) Route(link *url.URL, depth int) {
+	owner := n.ring.Load().Owner(link.Host)
+	n.outbox.add(owner, Link{URL: link.String(), Depth: depth})
+}
+
+// dispatch admits a delivered link, or forwards it when the ring changed
+// while it was in transit
+func (n *Node) dispatch(link *url.URL, depth int) {
+	if n.Owns(link.Host) {
+		n.crawler.Admit(link, depth)
+		return
+	}
+	n.Route(link, depth)
+}
+
+func (n *Node) flushLoop() {
+	defer n.done.Done()
+	ticker := time.NewTicker(n.outbox.options.FlushInterval)
+	defer ticker.Stop()
+	for {
+		select {
+		case <-n.quit:
+			n.flush()
+			return
+		case <-ticker.C:
+		case <-n.outbox.kick:
+		}
+		n.flush()
+	}
+}
+
+func (n *Node) flush() {
+	for owner, links := range n.outbox.take() {
+		if err := n.deliver(owner, links); err != nil {
+			n.outbox.failed(owner, links)
+			n.dropped.Add(uint64(len(links)))
+		} else {
+			n.sent.Add(uint64(len(links)))
+		}
+		n.outbox.done(len(links))
+	}
+}
+
+func (n *Node) deliver(owner string, links []Link) error {
+	if owner == n.addr {
+		for _, l := range links {
+			if link, err := url.Parse(l.URL); err == nil {
+				n.dispatch(link, l.Depth)
+			}
+		}
+		return nil
+	}
+
+	client, err := n.peer(owner)
+	if err != nil {
+		return err
+	}
+	batch := Batch{From: n.addr, Count: len(links), Payload: encodeBatch(links)}
+	var reply int
+	if err := client.Call("Exchange.Deliver", batch, &reply); err != nil {
+		n.mutex.Lock()
+		delete(n.peers, owner)
+		n.mutex.Unlock()
+		client.Close()
+		return err
+	}
+	return nil
+}
+
+func (n *Node) peer(addr string) (*rpc.Client, error) {
+	n.mutex.Lock()
+	defer n.mutex.Unlock()
+	if client, ok := n.peers[addr]; ok {
+		return client, nil
+	}
+	client, err := rpc.Dial("tcp", addr)
+	if err != nil {
+		return nil, err
+	}
+	n.peers[addr] = client
+	return client, nil
+}
+
+// Idle reports whether the node has no links to deliver and its crawler
+// nothing queued or in flight
+func (n *Node) Idle() bool {
+	return n.outbox.pending.Load() == 0 && n.crawler.Idle()
+}
+
+// Sent returns the number of links delivered to other nodes
+func (n *Node) Sent() uint64 {
+	return n.sent.Load()
+}
+
+// Duplicates returns the number of links the outbox dropped as recently sent
+func (n *Node) Duplicates() uint64 {
+	return n.outbox.duplicates.Load()
+}
+
+// Dropped returns the number of links that could not be delivered
+func (n *Node) Dropped() uint64 {
+	return n.dropped.Load()
+}
+
+// Close flushes the buffered links and stops the node, closing the
+// connections of its peers
+func (n *Node) Close() error {
+	close(n.quit)
+	err := n.listener.Close()
+	n.mutex.Lock()
+	n.closed = true
+	for conn := range n.conns {
+		conn.Close()
+	}
+	n.mutex.Unlock()
+	n.done.Wait()
+
+	n.mutex.Lock()
+	defer n.mutex.Unlock()
+	for _, client := range n.peers {
+		client.Close()
+	}
+	return err
+}
@@ -0,0 +1,135 @@
+package cluster_test
+
+import (
+	"context"
+	"net/url"
+	crawler "packages/src"
+	"packages/src/cluster"
+	"packages/src/fetcher"
+	"packages/src/synthweb"
+	"sync"
+	"testing"
+	"time"
+)
+
+// crawlCluster crawls farm with a cluster of nodes on localhost and returns
+// the URLs of the pages each node fetched
+func crawlCluster(t *testing.T, farm *synthweb.Farm, nodes int) ([]map[string]bool, []*cluster.Node) {
+	t.Helper()
+	settings := crawler.NewCrawlersettings(5*time.Second, time.Minute, 0, 8, 16, fetcher.Hrefparser{})
+	crawlers := make([]*crawler.Crawler, nodes)
+	members := make([]*cluster.Node, nodes)
+	addrs := make([]string, nodes)
+	for i := range crawlers {
+		f := fetcher.NewHttpfetcher(farm.Client(), settings.Parser(), "cluster-test")
+		crawlers[i] = crawler.NewCrawler(settings, f, crawler.NewMemorycache())
+		crawlers[i].SetResolver(farm)
+		n, err := cluster.NewNode("127.0.0.1:0", crawlers[i], cluster.Options{BatchSize: 16})
+		if err != nil {
+			t.Fatal(err)
+		}
+		t.Cleanup(func() { n.Close() })
+		members[i], addrs[i] = n, n.Addr()
+	}
+	for _, n := range members {
+		n.SetMembers(addrs)
+	}
+
+	ctx, cancel := context.WithTimeout(context.Background(), 30*time.Second)
+	defer cancel()
+	fetched := make([]map[string]bool, nodes)
+	var wg sync.WaitGroup
+	for i, c := range crawlers {
+		fetched[i] = make(map[string]bool)
+		results := make(chan *crawler.Parsedresults, 64)
+		// Every node is seeded with every host, and keeps its own
+		go c.Crawl(ctx, farm.Seeds(), results)
+		wg.Add(1)
+		go func(i int) {
+			defer wg.Done()
+			for res := range results {
+				if fetched[i][res.URL] {
+					t.Errorf("node %d fetched %s twice", i, res.URL)
+				}
+				fetched[i][res.URL] = true
+				res.Release()
+			}
+		}(i)
+	}
+
+	// Stop once every node stayed idle with no link exchanged over two polls
+	var last uint64
+	for quiet := 0; quiet < 2 && ctx.Err() == nil; {
+		time.Sleep(50 * time.Millisecond)
+		idle, sent := true, uint64(0)
+		for _, n := range members {
+			idle = idle && n.Idle()
+			sent += n.Sent() + n.Dropped()
+		}
+		if idle && sent == last {
+			quiet++
+		} else {
+			quiet = 0
+		}
+		last = sent
+	}
+	if ctx.Err() != nil {
+		t.Error("the cluster did not go quiet")
+	}
+	for _, c := range crawlers {
+		c.Stop()
+	}
+	wg.Wait()
+	return fetched, members
+}
+
+func TestNodesShareHosts(t *testing.T) {
+	config := synthweb.DefaultConfig()
+	config.Hosts, config.PagesPerHost, config.PageSize = 24, 20, 2<<10
+	config.External, config.Latency = 0.3, nil
+	config.RobotsRate, config.ErrorRate, config.Duplicates = 0, 0, 0
+	farm := synthweb.NewFarm(config)
+	defer farm.Close()
+
+	fetched, nodes := crawlCluster(t, farm, 3)
+
+	// Each host is fetched by exactly one node, each page once overall
+	owner := make(map[string]int)
+	pages := make(map[string]bool)
+	for i, links := range fetched {
+		if len(links) == 0 {
+			t.Errorf("node %d fetched nothing", i)
+		}
+		for link := range links {
+			u, err := url.Parse(link)
+			if err != nil {
+				t.Fatal(err)
+			}
+			if o, ok := owner[u.Host]; ok && o != i {
+				t.Errorf("%s fetched by nodes %d and %d", u.Host, o, i)
+			}
+			owner[u.Host] = i
+			if pages[link] {
+				t.Errorf("%s fetched by more than one node", link)
+			}
+			pages[link] = true
+		}
+	}
+	if len(owner) != config.Hosts {
+		t.Errorf("%d hosts fetched, want %d", len(owner), config.Hosts)
+	}
+
+	// Links to the hosts of other nodes are found on many pages, and only
+	// go out once from each node
+	var sent, duplicates uint64
+	for _, n := range nodes {
+		sent += n.Sent()
+		duplicates += n.Duplicates()
+		if n.Dropped() != 0 {
+			t.Errorf("node %s dropped %d links", n.Addr(), n.Dropped())
+		}
+	}
+	if sent == 0 || duplicates == 0 {
+		t.Errorf("%d links sent and %d dropped as duplicates, want both", sent, duplicates)
+	}
+}
@@ -0,0 +1,191 @@
+package cluster
+
+import (
+	"bytes"
+	"compress/flate"
+	"encoding/binary"
+	"errors"
+	"hash/fnv"
+	"io"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+const (
+	defaultbatchsize     = 512
+	defaultflushinterval = 20 * time.Millisecond
+	defaultfiltersize    = 1 << 16
+)
+
+var errCorruptBatch = errors.New("cluster: corrupt batch")
+
+// Options tunes the link exchange of a Node. Zero fields take defaults.
+type Options struct {
+	BatchSize     int           // links per destination that trigger a flush
+	FlushInterval time.Duration // longest a link waits in the outbox
+	FilterSize    int           // fingerprints remembered to drop duplicates
+}
+
+func (o Options) withDefaults() Options {
+	if o.BatchSize <= 0 {
+		o.BatchSize = defaultbatchsize
+	}
+	if o.FlushInterval <= 0 {
+		o.FlushInterval = defaultflushinterval
+	}
+	if o.FilterSize <= 0 {
+		o.FilterSize = defaultfiltersize
+	}
+	return o
+}
+
+// fingerprints is a direct-mapped table of the fingerprints of the links
+// recently sent, with their destination. It forgets entries on collisions,
+// so a duplicate may occasionally go out, but a new link is never mistaken
+// for a sent one short of a 64-bit hash collision. The fingerprints of the
+// links that could not be delivered are removed, and a link routed to
+// another node after the ring changed has another fingerprint. Receivers
+// deduplicate anyway; the filter only saves bandwidth.
+type fingerprints struct {
+	table []uint64
+	mask  uint64
+}
+
+func newFingerprints(size int) *fingerprints {
+	n := 1
+	for n < size {
+		n <<= 1
+	}
+	return &fingerprints{table: make([]uint64, n), mask: uint64(n - 1)}
+}
+
+// seen records fp and reports whether it was already present
+func (f *fingerprints) seen(fp uint64) bool {
+	slot := &f.table[fp&f.mask]
+	if *slot == fp {
+		return true
+	}
+	*slot = fp
+	return false
+}
+
+// forget removes fp, unless its slot was taken since
+func (f *fingerprints) forget(fp uint64) {
+	if slot := &f.table[fp&f.mask]; *slot == fp {
+		*slot = 0
+	}
+}
+
+func fingerprint(owner, link string) uint64 {
+	h := fnv.New64a()
+	io.WriteString(h, owner)
+	h.Write([]byte{0})
+	io.WriteString(h, link)
+	return h.Sum64() | 1 // zero marks an empty slot
+}
+
+// outbox buffers links per destination node, drops the ones it recently
+// sent and hands out compressed batches once a destination has enough links
+// or the flush interval elapsed.
+type outbox struct {
+	options Options
+	mutex   sync.Mutex
+	filter  *fingerprints
+	buffers map[string][]Link
+	kick    chan struct{}
+
+	pending    atomic.Int64 // links buffered or being delivered
+	duplicates atomic.Uint64
+}
+
+func newOutbox(options Options) *outbox {
+	return &outbox{
+		options: options,
+		filter:  newFingerprints(options.FilterSize),
+		buffers: make(map[string][]Link),
+		kick:    make(chan struct{}, 1),
+	}
+}
+
+// add buffers l for owner unless it was sent recently
+func (o *outbox) add(owner string, l Link) {
+	o.mutex.Lock()
+	if o.filter.seen(fingerprint(owner, l.URL)) {
+		o.mutex.Unlock()
+		o.duplicates.Add(1)
+		return
+	}
+	o.buffers[owner] = append(o.buffers[owner], l)
+	full := len(o.buffers[owner]) >= o.options.BatchSize
+	o.pending.Add(1)
+	o.mutex.Unlock()
+
+	if full {
+		select {
+		case o.kick <- struct{}{}:
+		default:
+		}
+	}
+}
+
+// take removes and returns every buffered link by destination
+func (o *outbox) take() map[string][]Link {
+	o.mutex.Lock()
+	defer o.mutex.Unlock()
+	buffers := o.buffers
+	o.buffers = make(map[string][]Link, len(buffers))
+	return buffers
+}
+
+// failed forgets that links were sent to owner, so that they go out again
+// when discovered anew
+func (o *outbox) failed(owner string, links []Link) {
+	o.mutex.Lock()
+	defer o.mutex.Unlock()
+	for _, l := range links {
+		o.filter.forget(fingerprint(owner, l.URL))
+	}
+}
+
+// done marks n links taken from the outbox as delivered or dropped
+func (o *outbox) done(n int) {
+	o.pending.Add(-int64(n))
+}
+
+// encodeBatch packs links as varint-prefixed records compressed with flate
+func encodeBatch(links []Link) []byte {
+	var raw []byte
+	for _, l := range links {
+		raw = binary.AppendUvarint(raw, uint64(l.Depth))
+		raw = binary.AppendUvarint(raw, uint64(len(l.URL)))
+		raw = append(raw, l.URL...)
+	}
+	var compressed bytes.Buffer
+	w, _ := flate.NewWriter(&compressed, flate.BestSpeed)
+	w.Write(raw)
+	w.Close()
+	return compressed.Bytes()
+}
+
+func decodeBatch(payload []byte, count int) ([]Link, error) {
+	raw, err := io.ReadAll(flate.NewReader(bytes.NewReader(payload)))
+	if err != nil {
+		return nil, err
+	}
+	links := make([]Link, 0, count)
+	for len(raw) > 0 {
+		depth, n := binary.Uvarint(raw)
+		if n <= 0 {
+			return links, errCorruptBatch
+		}
+		raw = raw[n:]
+		length, n := binary.Uvarint(raw)
+		if n <= 0 || uint64(len(raw)-n) < length {
+			return links, errCorruptBatch
+		}
+		links = append(links, Link{URL: string(raw[n : n+int(length)]), Depth: int(depth)})
+		raw = raw[n+int(length):]
+	}
+	return links, nil
+}
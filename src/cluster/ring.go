@@ -0,0 +1,77 @@
+// Package cluster spreads a crawl over several nodes. Hosts are assigned to
+// nodes with a consistent hash ring and discovered links are exchanged in
+// batches over net/rpc.
+package cluster
+
+import (
+	"hash/fnv"
+	"sort"
+	"strconv"
+)
+
+const defaultreplicas = 128
+
+// Ring is an immutable consistent hash ring. Each node is placed at several
+// virtual points so hosts spread evenly, and adding or removing a node only
+// moves the hosts between its points and their predecessors.
+type Ring struct {
+	points []uint64
+	owners []string
+	nodes  []string
+}
+
+// NewRing creates a new Ring struct with replicas virtual points per node
+func NewRing(replicas int, nodes ...string) *Ring {
+	r := &Ring{nodes: append([]string(nil), nodes...)}
+	sort.Strings(r.nodes)
+
+	type point struct {
+		hash  uint64
+		owner string
+	}
+	points := make([]point, 0, replicas*len(nodes))
+	for _, node := range r.nodes {
+		for i := 0; i < replicas; i++ {
+			points = append(points, point{hash(node + "#" + strconv.Itoa(i)), node})
+		}
+	}
+	sort.Slice(points, func(i, j int) bool { return points[i].hash < points[j].hash })
+
+	r.points = make([]uint64, len(points))
+	r.owners = make([]string, len(points))
+	for i, p := range points {
+		r.points[i], r.owners[i] = p.hash, p.owner
+	}
+	return r
+}
+
+// Owner returns the node owning key, or "" for an empty ring
+func (r *Ring) Owner(key string) string {
+	if len(r.points) == 0 {
+		return ""
+	}
+	h := hash(key)
+	i := sort.Search(len(r.points), func(i int) bool { return r.points[i] >= h })
+	if i == len(r.points) {
+		i = 0
+	}
+	return r.owners[i]
+}
+
+// Nodes returns the members of the ring
+func (r *Ring) Nodes() []string {
+	return r.nodes
+}
+
+// hash is FNV-1a followed by a splitmix64 finalizer, which spreads keys
+// that differ only in their last characters
+func hash(key string) uint64 {
+	f := fnv.New64a()
+	f.Write([]byte(key))
+	x := f.Sum64()
+	x ^= x >> 30
+	x *= 0xbf58476d1ce4e5b9
+	x ^= x >> 27
+	x *= 0x94d049bb133111eb
+	return x ^ x>>31
+}
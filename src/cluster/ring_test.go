@@ -0,0 +1,76 @@
+package cluster
+
+import (
+	"fmt"
+	"testing"
+)
+
+const ringhosts = 20000
+
+func owners(r *Ring) []string {
+	owned := make([]string, ringhosts)
+	for i := range owned {
+		owned[i] = r.Owner(fmt.Sprintf("h%05d.example.com", i))
+	}
+	return owned
+}
+
+func TestRingBalance(t *testing.T) {
+	nodes := []string{"10.0.0.1:7000", "10.0.0.2:7000", "10.0.0.3:7000", "10.0.0.4:7000"}
+	counts := make(map[string]int)
+	for _, owner := range owners(NewRing(defaultreplicas, nodes...)) {
+		counts[owner]++
+	}
+	for _, node := range nodes {
+		if share := float64(counts[node]) / ringhosts; share < 0.5/4 || share > 1.5/4 {
+			t.Errorf("%s owns %.3f of the hosts, want about 1/4", node, share)
+		}
+	}
+	if NewRing(defaultreplicas).Owner("example.com") != "" {
+		t.Error("an empty ring owns a host")
+	}
+}
+
+func TestRingMembershipChange(t *testing.T) {
+	nodes := []string{"10.0.0.1:7000", "10.0.0.2:7000", "10.0.0.3:7000"}
+	before := owners(NewRing(defaultreplicas, nodes...))
+
+	// A node joining takes about 1/4 of the hosts, from every other node
+	joined := "10.0.0.4:7000"
+	after := owners(NewRing(defaultreplicas, append(nodes, joined)...))
+	moved := 0
+	for i := range before {
+		if before[i] != after[i] {
+			moved++
+			if after[i] != joined {
+				t.Fatalf("host %d moved from %s to %s, not to the node joining", i, before[i], after[i])
+			}
+		}
+	}
+	if share := float64(moved) / ringhosts; share < 0.15 || share > 0.35 {
+		t.Errorf("%.3f of the hosts moved as a fourth node joined, want about 1/4", share)
+	}
+
+	// A node leaving hands over its hosts alone, about 1/3 of them
+	left := owners(NewRing(defaultreplicas, nodes[0], nodes[2]))
+	moved = 0
+	for i := range before {
+		if before[i] != left[i] {
+			moved++
+			if before[i] != nodes[1] {
+				t.Fatalf("host %d of %s moved as %s left", i, before[i], nodes[1])
+			}
+		}
+	}
+	if share := float64(moved) / ringhosts; share < 0.2 || share > 0.45 {
+		t.Errorf("%.3f of the hosts moved as one of three nodes left, want about 1/3", share)
+	}
+
+	// The order the members are given in does not matter
+	shuffled := owners(NewRing(defaultreplicas, nodes[2], nodes[0], nodes[1]))
+	for i := range before {
+		if before[i] != shuffled[i] {
+			t.Fatalf("host %d owned by %s or %s depending on the order of the members", i, before[i], shuffled[i])
+		}
+	}
+}
@@ -0,0 +1,225 @@
+// Command crawlbench crawls a synthetic web and reports the throughput and
+// resource usage of the crawler. The web is served by a child process, so
+// the allocations, GC and memory reported are those of the crawler alone.
+package main
+
+import (
+	"bufio"
+	"context"
+	"flag"
+	"fmt"
+	"io"
+	"log"
+	"net/http"
+	"os"
+	"os/exec"
+	"os/signal"
+	crawler "packages/src"
+	"packages/src/cluster"
+	"packages/src/diskio"
+	"packages/src/fetcher"
+	"packages/src/metrics"
+	"packages/src/profiling"
+	"packages/src/synthweb"
+	"strings"
+	"time"
+)
+
+func main() {
+	config := synthweb.DefaultConfig()
+	flag.IntVar(&config.Hosts, "hosts", config.Hosts, "number of synthetic hosts")
+	flag.IntVar(&config.PagesPerHost, "pages", config.PagesPerHost, "pages per host")
+	flag.IntVar(&config.PageSize, "pagesize", config.PageSize, "page body size in bytes")
+	flag.IntVar(&config.Fanout, "fanout", config.Fanout, "links per page")
+	flag.Float64Var(&config.External, "external", config.External, "fraction of off-host links")
+	flag.Float64Var(&config.RobotsRate, "robots", config.RobotsRate, "fraction of hosts with robots.txt rules")
+	flag.Float64Var(&config.ErrorRate, "errors", config.ErrorRate, "fraction of pages answering 500")
+	flag.Float64Var(&config.Flaky, "flaky", config.Flaky, "fraction of requests answering 503 at random")
+	flag.Float64Var(&config.Outages, "outages", config.Outages, "fraction of hosts answering 503 to everything")
+	flag.Float64Var(&config.Sitemaps, "sitemapsites", config.Sitemaps, "fraction of hosts listing their pages in sitemaps")
+	flag.Float64Var(&config.Junk, "junk", config.Junk, "fraction of links to mailto:, javascript: or images")
+	flag.IntVar(&config.Addresses, "addresses", config.Addresses, "addresses the hosts resolve to, 16 per /24, one per host when zero")
+	flag.Float64Var(&config.Traps, "trapsites", config.Traps, "fraction of hosts with an endless faceted search")
+	flag.Float64Var(&config.Duplicates, "duplicates", config.Duplicates, "fraction of pages mirroring their host root")
+	median := flag.Duration("latency", 5*time.Millisecond, "median response latency")
+	sigma := flag.Float64("sigma", 0.8, "log-normal latency spread, 0 for fixed latency")
+	concurrency := flag.Int("concurrency", 64, "fetch stage workers")
+	parsers := flag.Int("parsers", 0, "parse stage workers, GOMAXPROCS when zero")
+	filters := flag.Int("filters", 0, "filter stage workers, GOMAXPROCS when zero")
+	depth := flag.Int("depth", 16, "maximum link depth from the seeds")
+	delay := flag.Duration("delay", 0, "politeness delay between fetches of a host")
+	timeout := flag.Duration("timeout", 5*time.Minute, "crawl timeout")
+	metricsAddr := flag.String("metrics", "", "serve Prometheus metrics on this address")
+	profileDir := flag.String("profiledir", "", "capture profiles of slow crawls into this directory")
+	minRate := flag.Float64("minrate", 0, "pages/sec below which a profile is captured")
+	window := flag.Duration("window", 10*time.Second, "profile capture window")
+	spillDir := flag.String("spilldir", "", "spill the frontier to this directory")
+	head := flag.Int("head", 1024, "in-memory frontier entries per host when spilling")
+	checkpoint := flag.String("checkpoint", "", "save the crawl state to this directory, resuming the crawl it holds")
+	every := flag.Duration("checkpointevery", 10*time.Second, "interval between checkpoints, 0 for one when the crawl ends")
+	wal := flag.Duration("wal", 0, "commit interval of a write-ahead log of the checkpoints, 0 for none")
+	sink := flag.String("sink", "", "write the results as JSON lines to this file")
+	sinkBackend := flag.String("sinkbackend", "auto", "how the sink writes: auto, uring or threads")
+	sinkDepth := flag.Int("sinkdepth", 0, "sink blocks in flight, 8 when zero")
+	nearDistance := flag.Int("simhash", -1, "skip links of pages within this many SimHash bits of another, negative disables")
+	traps := flag.Bool("traps", false, "reject URLs of runaway patterns with the default trap limits")
+	nodes := flag.Int("nodes", 1, "cluster nodes sharing the crawl over localhost")
+	retry := fetcher.DefaultRetrypolicy()
+	flag.IntVar(&retry.Attempts, "attempts", retry.Attempts, "tries per fetch, 1 disables retries")
+	flag.DurationVar(&retry.Backoff, "backoff", retry.Backoff, "delay before the first retry, doubled after each")
+	flag.DurationVar(&retry.Hedge, "hedge", 0, "send a second request when the first is slower than this, 0 disables")
+	breakers := flag.Bool("breakers", false, "park failing hosts with the default circuit breaker limits")
+	var budget crawler.Budget
+	ranked := flag.Bool("ranked", false, "fetch the most valuable pages of each host first")
+	flag.IntVar(&budget.Pages, "budget", 0, "pages fetched per host, 0 for unlimited; implies -ranked")
+	flag.Float64Var(&budget.PerInlink, "perinlink", 0, "extra pages per host for each link from another host")
+	flag.IntVar(&budget.Top, "top", 0, "pages ranked per host, 64 when zero")
+	pagerank := flag.Duration("pagerank", 0, "rank pages by their importance in the link graph, swept at this interval; 0 disables")
+	graphLimit := flag.Int("pagerank-nodes", 0, "pages held by the link graph of -pagerank, about 4M when zero")
+	cooldown := flag.Duration("cooldown", crawler.DefaultBreakerlimits().Cooldown, "first pause of a host whose breaker opens")
+	sitemaps := flag.Bool("sitemaps", false, "queue the URLs listed by the sitemaps of robots.txt")
+	since := flag.String("since", "", "skip sitemap URLs unchanged since this date (2006-01-02)")
+	deny := flag.String("deny", "", "comma separated path extensions of the links not followed, like .jpg,.png")
+	polite := flag.String("politeness", "host", "what the crawl delay spaces fetches of: host, address or subnet")
+	var limits crawler.Ratelimits
+	flag.Float64Var(&limits.Global.Rate, "qps", 0, "fetches per second of the whole crawl, 0 for unlimited")
+	flag.Float64Var(&limits.Global.Bandwidth, "bandwidth", 0, "body bytes per second of the whole crawl, 0 for unlimited")
+	flag.Float64Var(&limits.IP.Rate, "ipqps", 0, "fetches per second per host address, 0 for unlimited")
+	flag.Float64Var(&limits.Subnet.Rate, "subnetqps", 0, "fetches per second per /24 subnet, 0 for unlimited")
+	flag.Float64Var(&limits.Host.Rate, "hostqps", 0, "fetches per second per host, 0 for unlimited")
+	batch := flag.Int("batch", 512, "links per cluster batch")
+	flush := flag.Duration("flush", 20*time.Millisecond, "longest a link waits before being sent to its node")
+	serve := flag.Bool("servefarm", false, "serve the synthetic web for the crawling parent process")
+	inprocess := flag.Bool("inprocess", false, "serve the synthetic web from the crawling process, its costs reported along")
+	flag.Parse()
+
+	if *sigma > 0 {
+		config.Latency = synthweb.Lognormal{Median: *median, Sigma: *sigma}
+	} else {
+		config.Latency = synthweb.Fixed(*median)
+	}
+	if *serve {
+		serveFarm(config)
+		return
+	}
+
+	var options synthweb.Options
+	if *metricsAddr != "" {
+		options.Registry = metrics.NewRegistry()
+		go func() {
+			log.Fatal(http.ListenAndServe(*metricsAddr, options.Registry))
+		}()
+	}
+	if *profileDir != "" {
+		options.Capturer = profiling.NewCapturer(*profileDir, *window, 6**window)
+		options.MinRate = *minRate
+	}
+
+	options.SpillDir = *spillDir
+	options.Head = *head
+	options.Checkpoint, options.Every, options.WAL = *checkpoint, *every, *wal
+	backend, err := diskio.ParseBackend(*sinkBackend)
+	if err != nil {
+		log.Fatal(err)
+	}
+	options.Sink, options.SinkIO = *sink, diskio.Options{Backend: backend, Depth: *sinkDepth}
+	options.Nodes = *nodes
+	options.Simhash = *nearDistance
+	options.Parsers, options.Filters = *parsers, *filters
+	options.Retry = &retry
+	options.Sitemaps = *sitemaps
+	switch *polite {
+	case "host":
+	case "address":
+		options.Polite = crawler.Peraddress
+	case "subnet":
+		options.Polite = crawler.Persubnet
+	default:
+		log.Fatalf("unknown politeness %q", *polite)
+	}
+	if limits != (crawler.Ratelimits{}) {
+		options.Limits = &limits
+	}
+	if *deny != "" {
+		options.Deny = strings.Split(*deny, ",")
+	}
+	if *since != "" {
+		t, err := time.Parse("2006-01-02", *since)
+		if err != nil {
+			log.Fatal(err)
+		}
+		options.Since = t
+	}
+	if *breakers {
+		limits := crawler.DefaultBreakerlimits()
+		limits.Cooldown = *cooldown
+		options.Breakers = &limits
+	}
+	if *traps {
+		limits := crawler.DefaultTraplimits()
+		options.Traps = &limits
+	}
+	if *ranked || budget.Pages > 0 {
+		options.Budget = &budget
+	}
+	options.Linkgraph = *pagerank
+	options.GraphLimit = *graphLimit
+	options.Exchange = cluster.Options{BatchSize: *batch, FlushInterval: *flush}
+
+	var farm *synthweb.Farm
+	if *inprocess {
+		farm = synthweb.NewFarm(config)
+		defer farm.Close()
+	} else {
+		var stop func()
+		farm, stop = startFarm(config)
+		defer stop()
+	}
+
+	settings := crawler.NewCrawlersettings(10*time.Second, *timeout, *delay,
+		*concurrency, *depth, fetcher.Hrefparser{})
+	// An interrupt ends the crawl early, still reporting on it
+	ctx, stop := signal.NotifyContext(context.Background(), os.Interrupt)
+	defer stop()
+	report, err := synthweb.Run(ctx, farm, settings, options)
+	if err != nil {
+		log.Fatal(err)
+	}
+	fmt.Println(report)
+}
+
+// serveFarm serves the farm of config, printing its address, until the
+// parent process closes the standard input
+func serveFarm(config synthweb.Config) {
+	farm := synthweb.NewFarm(config)
+	defer farm.Close()
+	fmt.Println(farm.Addr())
+	io.Copy(io.Discard, os.Stdin)
+}
+
+// startFarm serves the farm of config from a child process running with the
+// same flags, until stop is called or this process exits
+func startFarm(config synthweb.Config) (farm *synthweb.Farm, stop func()) {
+	child := exec.Command(os.Args[0], append([]string{"-servefarm"}, os.Args[1:]...)...)
+	child.Stderr = os.Stderr
+	stdout, err := child.StdoutPipe()
+	if err != nil {
+		log.Fatal(err)
+	}
+	// Never written, the child stops once it is closed
+	stdin, err := child.StdinPipe()
+	if err != nil {
+		log.Fatal(err)
+	}
+	if err := child.Start(); err != nil {
+		log.Fatal(err)
+	}
+	addr, err := bufio.NewReader(stdout).ReadString('\n')
+	if err != nil {
+		log.Fatalf("synthetic web: %v", err)
+	}
+	return synthweb.NewRemoteFarm(config, strings.TrimSpace(addr)), func() {
+		stdin.Close()
+		child.Wait()
+	}
+}
@@ -1,10 +1,19 @@
 package crawler
 
 import (
+	"context"
+	"net"
 	"net/http"
+	"net/netip"
 	"net/url"
 	// "packages/src/crawler"
 	"packages/src/fetcher"
+	"packages/src/linkgraph"
+	"packages/src/profiling"
+	"packages/src/simhash"
+	"runtime"
+	"sync"
+	"sync/atomic"
 	"time"
 )
 
@@ -17,13 +26,23 @@ const (
 	defaultUserAgent       string        = "Mozilla/5.0 (compatible; Googlebot/2.1; +http://www.google.com/bot.html)"
 )
 
+// Fetcher issues requests that are abandoned once their context is done
 type Fetcher interface {
-	Fetch(string) (time.Duration, *http.Response, error)
+	Fetch(context.Context, string) (time.Duration, *http.Response, error)
 }
 
 type Linkfetcher interface {
 	Fetcher
-	Fetchlinks(string) (time.Duration, []*url.URL, error)
+	Fetchlinks(context.Context, string) (time.Duration, []*url.URL, error)
+}
+
+// Pagefetcher is a Linkfetcher that downloads a page into a fetcher.Page and
+// parses it in a separate step, so both can run in different pipeline
+// stages. The links of the page live in its arena instead of the heap.
+type Pagefetcher interface {
+	Linkfetcher
+	Fetchbody(context.Context, string, *fetcher.Page) (time.Duration, error)
+	Parsepage(context.Context, string, *fetcher.Page) error
 }
 
 type Parsedresults struct {
@@ -31,9 +50,395 @@ type Parsedresults struct {
 	Links []string `json: "Links"`
 }
 
+var resultspool = sync.Pool{
+	New: func() any { return new(Parsedresults) },
+}
+
+func newParsedresults(url string) *Parsedresults {
+	res := resultspool.Get().(*Parsedresults)
+	res.URL = url
+	return res
+}
+
+// Release recycles the result once its consumer is done with it. The result
+// must not be used afterwards; consumers that keep results simply do not
+// call it.
+func (r *Parsedresults) Release() {
+	clear(r.Links)
+	r.URL, r.Links = "", r.Links[:0]
+	resultspool.Put(r)
+}
+
 type Crawlersettings struct {
-	fetchtimeout time.Duration
-	crawltimeout time.Duration
-	concurrency  int
-	parser       fetcher.Parser
+	fetchtimeout    time.Duration
+	crawltimeout    time.Duration
+	politenessdelay time.Duration
+	concurrency     int
+	depth           int
+	parser          fetcher.Parser
+}
+
+// NewCrawlersettings creates a new Crawlersettings struct
+func NewCrawlersettings(fetchtimeout, crawltimeout, politenessdelay time.Duration,
+	concurrency, depth int, parser fetcher.Parser) *Crawlersettings {
+	return &Crawlersettings{
+		fetchtimeout:    fetchtimeout,
+		crawltimeout:    crawltimeout,
+		politenessdelay: politenessdelay,
+		concurrency:     concurrency,
+		depth:           depth,
+		parser:          parser,
+	}
+}
+
+// DefaultCrawlersettings returns the settings built from the package defaults
+func DefaultCrawlersettings(parser fetcher.Parser) *Crawlersettings {
+	return NewCrawlersettings(defaultfetchtimeout, defaultcrawltimeout,
+		defaultpolitenessdelay, defaultconcurrency, defaultdepth, parser)
+}
+
+// FetchTimeout returns the per-request timeout
+func (s *Crawlersettings) FetchTimeout() time.Duration {
+	return s.fetchtimeout
+}
+
+// Parser returns the parser links are extracted with
+func (s *Crawlersettings) Parser() fetcher.Parser {
+	return s.parser
+}
+
+// hoststate holds the rules, politeness schedule, rate limits and circuit
+// breaker of a single host
+type hoststate struct {
+	once     sync.Once
+	rules    *Crawlingrules
+	filter   *fetcher.Linkfilter
+	buckets  [numRatelevels]*ratebucket
+	schedule *schedule
+
+	breaker breaker
+}
+
+// admit reserves a fetch of the host if its crawl delay and the rate limits
+// allow one now. Otherwise it returns how long until they may, and the
+// level holding the fetch back.
+func (h *hoststate) admit(l *limiter) (time.Duration, ratelevel) {
+	s := h.schedule
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
+	now := time.Now()
+	if wait := s.next.Sub(now); wait > 0 {
+		return wait, delaylevel
+	}
+	if wait, level := l.reserve(now, &h.buckets); wait > 0 {
+		return wait, level
+	}
+	s.next = now.Add(h.rules.CrawlDelay())
+	return 0, delaylevel
+}
+
+// hedges reports whether the fetches of the host may be hedged. A hedge is
+// a second request the limiter never sees, so only hosts without a crawl
+// delay or rate limit get them.
+func (h *hoststate) hedges() bool {
+	return h.rules.CrawlDelay() == 0 && h.buckets == [numRatelevels]*ratebucket{}
+}
+
+// wait blocks until the crawl delay of the host allows a fetch and reserves
+// it, for fetches outside the pipeline, whose workers use admit instead. It
+// returns the time spent waiting, and false if ctx was done first.
+func (h *hoststate) wait(ctx context.Context) (time.Duration, bool) {
+	s := h.schedule
+	s.mutex.Lock()
+	now := time.Now()
+	start := s.next
+	if start.Before(now) {
+		start = now
+	}
+	s.next = start.Add(h.rules.CrawlDelay())
+	s.mutex.Unlock()
+
+	wait := time.Until(start)
+	if wait <= 0 {
+		return 0, ctx.Err() == nil
+	}
+	timer := time.NewTimer(wait)
+	defer timer.Stop()
+	select {
+	case <-timer.C:
+		return wait, true
+	case <-ctx.Done():
+		return wait - time.Until(start), false
+	}
+}
+
+// Crawler walks the seed domains with a pool of workers, honoring robots.txt
+// and the per-host crawl delay. Links leaving the domain of the page they were
+// found on are not followed unless the crawler is part of a cluster.
+type Crawler struct {
+	settings  *Crawlersettings
+	fetcher   Linkfetcher
+	cache     Cacheable
+	userAgent string
+	metrics   *Crawlermetrics
+	capturer  *profiling.Capturer
+	minRate   float64
+	fetched   atomic.Int64
+	router    Router
+	nearDups  *simhash.Index
+	traps     *Traplimits
+	breakers  *Breakerlimits
+	retries   fetcher.Retrypolicy
+	limiter   *limiter
+	resolver  Resolver
+
+	checkpoints *checkpointer
+
+	graph      *linkgraph.Graph
+	graphEvery time.Duration
+
+	politeness Politeness
+	schedules  map[string]*schedule
+
+	schemes, denied []string
+
+	sitemaps     bool
+	sitemapSince time.Time
+	sitemapSlots chan struct{}
+
+	hostsMutex sync.Mutex
+	hosts      map[string]*hoststate
+
+	frontier *Frontier
+
+	parsers, filters int
+	stages           []*stage
+	started, ended   atomic.Int64
+	cancel           atomic.Pointer[context.CancelFunc]
+}
+
+// NewCrawler creates a new Crawler struct
+func NewCrawler(settings *Crawlersettings, linkfetcher Linkfetcher,
+	cache Cacheable) *Crawler {
+	return &Crawler{
+		settings:  settings,
+		fetcher:   linkfetcher,
+		cache:     cache,
+		userAgent: defaultUserAgent,
+		metrics:   &Crawlermetrics{},
+		hosts:     make(map[string]*hoststate),
+		schedules: make(map[string]*schedule),
+		frontier:  NewFrontier(settings.depth),
+		parsers:   runtime.GOMAXPROCS(0),
+		filters:   runtime.GOMAXPROCS(0),
+		schemes:   []string{"http", "https"},
+		retries:   fetcher.DefaultRetrypolicy(),
+	}
+}
+
+// SetMetrics makes the crawler record its activity in m
+func (c *Crawler) SetMetrics(m *Crawlermetrics) {
+	c.metrics = m
+	c.frontier.SetMetrics(m.frontierDepth)
+}
+
+// SetTraplimits makes the crawler reject the URLs of each host that fall
+// outside limits as crawler traps
+func (c *Crawler) SetTraplimits(limits Traplimits) {
+	c.traps = &limits
+}
+
+// SetLinkfilter sets the schemes of the links followed, http and https by
+// default, and the path extensions whose links are not. Pagefetchers drop
+// the other links while parsing, along with the links leaving the host of
+// their page unless the crawler is part of a cluster.
+func (c *Crawler) SetLinkfilter(schemes, denied []string) {
+	c.schemes, c.denied = schemes, denied
+}
+
+// SetSpill bounds the in-memory frontier to headLimit URLs per host and
+// spills the rest to disk under dir
+func (c *Crawler) SetSpill(dir string, headLimit int) error {
+	return c.frontier.EnableSpill(dir, headLimit)
+}
+
+// Crawl visits every page reachable from seeds until the frontier drains,
+// the crawl timeout expires or ctx is done. The last two abort the fetches
+// and parses in flight. A result is sent for each fetched page and the
+// results channel is closed when the crawl ends. Results may be handed back
+// with Release once consumed.
+func (c *Crawler) Crawl(ctx context.Context, seeds []string, results chan<- *Parsedresults) {
+	defer close(results)
+	defer c.frontier.Close()
+
+	ctx, cancel := context.WithTimeout(ctx, c.settings.crawltimeout)
+	defer cancel()
+	c.cancel.Store(&cancel)
+	defer context.AfterFunc(ctx, c.frontier.Stop)()
+
+	for _, seed := range seeds {
+		link, err := url.Parse(seed)
+		if err != nil || link.Host == "" {
+			continue
+		}
+		if c.router != nil {
+			c.follow(link, 0)
+			continue
+		}
+		// Seen already when the crawl resumes
+		base := baseOf(link).String()
+		if c.cache.Contains(base, link.String()) {
+			continue
+		}
+		c.cache.Set(base, link.String())
+		c.enqueue(link, 0)
+	}
+
+	if c.capturer != nil {
+		stop := c.capturer.Watch(c.fetched.Load, c.minRate, c.settings.crawltimeout)
+		defer stop()
+	}
+
+	var checkpointed func() error
+	var weighed func()
+	if c.checkpoints != nil {
+		checkpointed = c.checkpointing()
+	}
+	if c.graph != nil {
+		weighed = c.weighing()
+	}
+	c.started.Store(time.Now().UnixNano())
+	unsent := c.pipeline(ctx, results)
+	c.ended.Store(time.Now().UnixNano())
+	if weighed != nil {
+		weighed()
+	}
+	if checkpointed != nil {
+		err := checkpointed()
+		// Held by a broken write-ahead log: sent once the last checkpoint
+		// holds their page as done, dropped to be fetched again otherwise
+		for _, res := range unsent {
+			if err == nil {
+				results <- res
+			} else {
+				res.Release()
+			}
+		}
+	}
+}
+
+// host returns the state of the link's host, loading its robots.txt on
+// first use, and starting to read its sitemaps when enabled.
+func (c *Crawler) host(ctx context.Context, link *url.URL) *hoststate {
+	c.hostsMutex.Lock()
+	h, ok := c.hosts[link.Host]
+	if !ok {
+		h = &hoststate{}
+		c.hosts[link.Host] = h
+	}
+	c.hostsMutex.Unlock()
+
+	h.once.Do(func() {
+		base := baseOf(link)
+		var sitemaps []string
+		c.phase(link.Host, "robots", func() {
+			h.rules, sitemaps = c.loadRules(ctx, base)
+		})
+		h.filter = &fetcher.Linkfilter{Schemes: c.schemes, Deny: c.denied}
+		if c.router == nil {
+			h.filter.Hosts = []string{base.Hostname()}
+		}
+		var addr netip.Addr
+		if c.limiter.resolves() || c.politeness != Perhost {
+			addr = c.resolve(ctx, base.Hostname())
+		}
+		h.buckets = c.limiter.bucketsOf(link.Host, addr)
+		var key string
+		if h.schedule, key = c.scheduleOf(link.Host, addr); key != link.Host {
+			c.frontier.Group(link.Host, key)
+		}
+		if c.sitemaps && len(sitemaps) > 0 {
+			c.ingest(ctx, h, base, sitemaps)
+		}
+	})
+	return h
+}
+
+// loadRules returns the crawling rules of the host at base, with the
+// sitemaps its robots.txt lists. The robots.txt of the hosts restored from
+// a checkpoint is not fetched again, nor are their sitemaps.
+func (c *Crawler) loadRules(ctx context.Context, base *url.URL) (*Crawlingrules, []string) {
+	rules := NewCrawlingRules(base, c.cache, c.settings.politenessdelay)
+	rules.decisions.counts = &c.metrics.decisions
+	if c.traps != nil {
+		rules.SetTraplimits(*c.traps)
+	}
+
+	var (
+		group    *Group
+		sitemaps []string
+		restored bool
+	)
+	if c.checkpoints != nil {
+		group, restored = c.checkpoints.robots[base.Host]
+	}
+	if !restored {
+		group, sitemaps = c.fetchRobots(ctx, base)
+		// A fetch cut short by the end of the crawl is not remembered
+		if ctx.Err() == nil {
+			c.checkpoints.fetchedRobots(base.Host, group)
+		}
+	}
+	if group != nil {
+		rules.SetRobotsGroup(group)
+	}
+	return rules, sitemaps
+}
+
+// fetchRobots returns the robots.txt group of the host at base applying to
+// the crawler, with the sitemaps it lists
+func (c *Crawler) fetchRobots(ctx context.Context, base *url.URL) (*Group, []string) {
+	ctx, cancel := context.WithTimeout(ctx, c.settings.fetchtimeout)
+	defer cancel()
+	_, resp, err := c.fetcher.Fetch(fetcher.Paced(ctx, 0), base.String()+"/robots.txt")
+	if err != nil {
+		return nil, nil
+	}
+	defer resp.Body.Close()
+
+	if resp.StatusCode != http.StatusOK {
+		return nil, nil
+	}
+	return ParseRobots(resp.Body, c.userAgent)
+}
+
+// resolve returns the first address of host, the zero Addr when it does not
+// resolve
+func (c *Crawler) resolve(ctx context.Context, host string) netip.Addr {
+	if addr, err := netip.ParseAddr(host); err == nil {
+		return addr
+	}
+	resolver := c.resolver
+	if resolver == nil {
+		resolver = net.DefaultResolver
+	}
+	ctx, cancel := context.WithTimeout(ctx, c.settings.fetchtimeout)
+	defer cancel()
+	addrs, err := resolver.LookupNetIP(ctx, "ip", host)
+	if err != nil || len(addrs) == 0 {
+		return netip.Addr{}
+	}
+	return addrs[0]
+}
+
+func (c *Crawler) enqueue(link *url.URL, depth int) {
+	if !c.frontier.Push(link, depth) {
+		c.metrics.pruned.Inc()
+		return
+	}
+	c.checkpoints.enqueue(link, depth)
+}
+
+func baseOf(link *url.URL) *url.URL {
+	return &url.URL{Scheme: link.Scheme, Host: link.Host}
 }
@@ -1,10 +1,15 @@
 package crawler
 
 import (
+	"bufio"
+	"io"
 	"math"
 	"math/rand"
 	"net/url"
+	"packages/src/arena"
+	"packages/src/fetcher"
 	"regexp"
+	"strconv"
 	"strings"
 	"sync"
 	"time"
@@ -23,6 +28,8 @@ type Group struct {
 	// test *Test()
 }
 
+// Cacheable records the visited URLs of each domain. Set must copy the
+// strings it keeps: they may point into memory reused after the call.
 type Cacheable interface {
 	Set(string, string)
 	Contains(string, string) bool
@@ -30,21 +37,126 @@ type Cacheable interface {
 
 type Crawlingrules struct {
 	baseDomain   *url.URL
+	baseKey      string
 	cache        Cacheable
 	robotsGroups *Group
 	fixedDelay   time.Duration
-	lastDelay    time.Duration
+	traps        *trapdetector
+	decisions    decisioncache
 	rwMutex      sync.RWMutex
 }
 
 // NewCrawlingRules creates a new CrawlingRules struct
 func NewCrawlingRules(baseDomain *url.URL, cache Cacheable,
 	fixedDelay time.Duration) *Crawlingrules {
-	return &Crawlingrules{
+	r := &Crawlingrules{
 		baseDomain: baseDomain,
+		baseKey:    baseDomain.String(),
 		cache:      cache,
 		fixedDelay: fixedDelay,
 	}
+	r.decisions.reset(nil)
+	return r
+}
+
+// SetRobotsGroup installs the robots.txt group that applies to our user agent.
+// It must be called before the rules are shared between workers. The
+// decisions cached for the previous group are dropped.
+func (r *Crawlingrules) SetRobotsGroup(g *Group) {
+	r.rwMutex.Lock()
+	defer r.rwMutex.Unlock()
+	r.robotsGroups = g
+	r.decisions.reset(g)
+}
+
+// SetTraplimits rejects URLs falling outside limits as crawler traps. It
+// must be called before the rules are shared between workers.
+func (r *Crawlingrules) SetTraplimits(limits Traplimits) {
+	r.traps = newTrapdetector(limits)
+}
+
+// ParseRobots reads a robots.txt body and returns the group matching agent,
+// falling back to the wildcard group, along with the URLs of the Sitemap
+// lines. The group is nil when none applies.
+func ParseRobots(body io.Reader, agent string) (*Group, []string) {
+	var groups, current []*Group
+	var sitemaps []string
+	inAgents := false
+
+	scanner := bufio.NewScanner(body)
+	for scanner.Scan() {
+		line := scanner.Text()
+		if i := strings.IndexByte(line, '#'); i >= 0 {
+			line = line[:i]
+		}
+		key, value, ok := strings.Cut(line, ":")
+		if !ok {
+			continue
+		}
+		key = strings.ToLower(strings.TrimSpace(key))
+		value = strings.TrimSpace(value)
+
+		switch key {
+		case "user-agent":
+			if !inAgents {
+				current = nil
+			}
+			g := &Group{agent: strings.ToLower(value)}
+			groups = append(groups, g)
+			current = append(current, g)
+			inAgents = true
+			continue
+		case "allow", "disallow":
+			if value == "" {
+				break
+			}
+			rule := newRule(value, key == "allow")
+			for _, g := range current {
+				g.rules = append(g.rules, rule)
+			}
+		case "sitemap":
+			// Sitemaps belong to no group and do not end one
+			if value != "" {
+				sitemaps = append(sitemaps, value)
+			}
+			continue
+		case "crawl-delay":
+			if secs, err := strconv.ParseFloat(value, 64); err == nil {
+				for _, g := range current {
+					g.crawlDelay = time.Duration(secs * float64(time.Second))
+				}
+			}
+		}
+		inAgents = false
+	}
+
+	agent = strings.ToLower(agent)
+	var wildcard *Group
+	for _, g := range groups {
+		if g.agent == "*" {
+			if wildcard == nil {
+				wildcard = g
+			}
+		} else if strings.Contains(agent, g.agent) {
+			return g, sitemaps
+		}
+	}
+	return wildcard, sitemaps
+}
+
+func newRule(path string, allow bool) *Rule {
+	r := &Rule{path: path, allow: allow}
+	if strings.ContainsAny(path, "*$") {
+		// Wildcards become a regexp anchored at the start of the path,
+		// a trailing $ anchors the end.
+		expr := regexp.QuoteMeta(path)
+		expr = strings.ReplaceAll(expr, `\*`, ".*")
+		if strings.HasSuffix(expr, `\$`) {
+			expr = strings.TrimSuffix(expr, `\$`) + "$"
+		}
+		r.pattern = regexp.MustCompile("^" + expr)
+	}
+	return r
 }
 
 func (g *Group) findRule(path string) (ret *Rule) {
@@ -89,21 +201,86 @@ func subdomain(domain *url.URL, link *url.URL) bool {
 	return (link.Hostname() == domain.Hostname() || link.Hostname() == "")
 }
 
+// Verdict is the outcome of testing an URL against the crawling rules
+type Verdict int
+
+const (
+	Accepted Verdict = iota
+	Visited
+	Robots
+	Offdomain
+	Trap
+	numVerdicts
+)
+
+func (v Verdict) String() string {
+	switch v {
+	case Accepted:
+		return "accepted"
+	case Visited:
+		return "visited"
+	case Robots:
+		return "robots"
+	case Offdomain:
+		return "offdomain"
+	case Trap:
+		return "trap"
+	}
+	return "unknown"
+}
+
 // Allowed tests for eligibility of an URL to be crawled, based on the rules
 // of the robots.txt file on the server. If no valid robots.txt is found all
 // URLs in the domain are assumed to be allowed, returning true.
 
 func (r *Crawlingrules) Allowed(url *url.URL) bool {
-	if r.cache.Contains(r.baseDomain.String(), url.String()) {
-		return false
+	return r.Check(url) == Accepted
+}
+
+// Permits tests the URL against the robots.txt rules alone. The verdicts
+// of the directories of the host are cached.
+func (r *Crawlingrules) Permits(url *url.URL) bool {
+	return r.robotsGroups == nil || r.decisions.test(r.robotsGroups, url.RequestURI())
+}
+
+// Check is Allowed reporting the reason an URL is rejected. URLs caught in
+// a crawler trap are not recorded as visited, so runaway URL spaces do not
+// grow the cache.
+func (r *Crawlingrules) Check(url *url.URL) Verdict {
+	return r.Checkin(url, nil)
+}
+
+// Checkin is Check building the cache key of url in scratch, when not nil,
+// instead of the heap
+func (r *Crawlingrules) Checkin(url *url.URL, scratch *arena.Arena) Verdict {
+	key := cachekey(url, scratch)
+	if r.cache.Contains(r.baseKey, key) {
+		return Visited
 	}
 
-	defer r.cache.Set(r.baseDomain.String(), url.String())
+	verdict := Accepted
+	switch {
+	case !subdomain(r.baseDomain, url):
+		verdict = Offdomain
+	case !r.Permits(url):
+		verdict = Robots
+	case r.traps != nil && r.traps.trap(url):
+		return Trap
+	}
+	r.cache.Set(r.baseKey, key)
+	return verdict
+}
 
-	if r.robotsGroups != nil {
-		return r.robotsGroups.Test(url.RequestURI()) && subdomain(r.baseDomain, url)
+// cachekey returns url.String(), serialized into scratch when the URL is
+// plain enough to need no escaping
+func cachekey(url *url.URL, scratch *arena.Arena) string {
+	if scratch == nil || !fetcher.Plainurl(url) {
+		return url.String()
+	}
+	if url.RawQuery == "" {
+		return scratch.String(url.Scheme, "://", url.Host, url.Path)
 	}
-	return subdomain(r.baseDomain, url)
+	return scratch.String(url.Scheme, "://", url.Host, url.Path, "?", url.RawQuery)
 }
 
 func randDelay(value int64) time.Duration {
@@ -130,12 +307,9 @@ func (r *Crawlingrules) CrawlDelay() time.Duration {
 
 	// We calculate a random value: 0.5*fixedDelay < value < 1.5*fixedDelay
 	randomDelay := randDelay(int64(r.fixedDelay.Milliseconds())) * time.Millisecond
-	baseDelay := time.Duration(
-		math.Max(float64(randomDelay.Milliseconds()), float64(delay.Milliseconds())),
-	) * time.Millisecond
-	// We return the max between the random value calculated and the lastDelay
+	// We return the max between the random value calculated and the robots delay
 	return time.Duration(
-		math.Max(float64(r.lastDelay.Milliseconds()), float64(baseDelay.Milliseconds())),
+		math.Max(float64(randomDelay.Milliseconds()), float64(delay.Milliseconds())),
 	) * time.Millisecond
 
 }
@@ -0,0 +1,168 @@
+package crawler
+
+import (
+	"packages/src/metrics"
+	"strings"
+	"sync"
+)
+
+const decisionslots = 256 // directories remembered per host
+
+// Outcomes of the lookups of the robots decision cache
+const (
+	decisionHit = iota
+	decisionMiss
+	decisionMixed
+	numDecisionOutcomes
+)
+
+var decisionOutcomes = [numDecisionOutcomes]string{"hit", "miss", "mixed"}
+
+// decisioncache remembers the robots.txt verdict of the directories of a
+// host, evicting the least recently used. A directory holds a single verdict
+// when no rule can tell its paths apart: no plain rule reaches below it and
+// no wildcard rule applies within it. The other directories are remembered
+// as mixed, and their paths matched one by one.
+type decisioncache struct {
+	mutex  sync.Mutex
+	group  *Group // the group the decisions were made with
+	slots  map[string]int32
+	nodes  []decisionnode
+	head   int32 // most recently used node, -1 when empty
+	counts *[numDecisionOutcomes]*metrics.Counter
+}
+
+type decisionnode struct {
+	dir        string
+	allow      bool
+	mixed      bool
+	prev, next int32
+}
+
+// reset drops the decisions, which are made with g from then on
+func (c *decisioncache) reset(g *Group) {
+	c.mutex.Lock()
+	defer c.mutex.Unlock()
+	c.group = g
+	clear(c.slots)
+	c.nodes, c.head = c.nodes[:0], -1
+}
+
+// test is g.Test(uri), answered from the verdict of the directory of uri
+// when it is cached
+func (c *decisioncache) test(g *Group, uri string) bool {
+	dir := directory(uri)
+	c.mutex.Lock()
+	i, ok := c.slots[dir]
+	if ok {
+		c.touch(i)
+		node := c.nodes[i]
+		c.mutex.Unlock()
+		if node.mixed {
+			c.count(decisionMixed)
+			return g.Test(uri)
+		}
+		c.count(decisionHit)
+		return node.allow
+	}
+	c.mutex.Unlock()
+
+	allow, mixed := g.Test(uri), !g.uniform(dir)
+	if mixed {
+		c.count(decisionMixed)
+	} else {
+		c.count(decisionMiss)
+	}
+	c.mutex.Lock()
+	if c.group == g {
+		c.insert(dir, allow, mixed)
+	}
+	c.mutex.Unlock()
+	return allow
+}
+
+func (c *decisioncache) count(outcome int) {
+	if c.counts != nil {
+		c.counts[outcome].Inc()
+	}
+}
+
+// insert caches the verdict of dir as the most recently used, evicting the
+// least recently used once full
+func (c *decisioncache) insert(dir string, allow, mixed bool) {
+	if _, ok := c.slots[dir]; ok {
+		return
+	}
+	if c.slots == nil {
+		c.slots = make(map[string]int32, decisionslots)
+	}
+	var i int32
+	if len(c.nodes) < decisionslots {
+		i = int32(len(c.nodes))
+		c.nodes = append(c.nodes, decisionnode{})
+	} else {
+		i = c.nodes[c.head].prev
+		c.unlink(i)
+		delete(c.slots, c.nodes[i].dir)
+	}
+	c.nodes[i] = decisionnode{dir: strings.Clone(dir), allow: allow, mixed: mixed}
+	c.slots[c.nodes[i].dir] = i
+	c.push(i)
+}
+
+// touch moves node i to the front of the list
+func (c *decisioncache) touch(i int32) {
+	if i != c.head {
+		c.unlink(i)
+		c.push(i)
+	}
+}
+
+// push links node i at the front of the circular list
+func (c *decisioncache) push(i int32) {
+	if c.head < 0 {
+		c.nodes[i].prev, c.nodes[i].next = i, i
+	} else {
+		tail := c.nodes[c.head].prev
+		c.nodes[i].prev, c.nodes[i].next = tail, c.head
+		c.nodes[tail].next, c.nodes[c.head].prev = i, i
+	}
+	c.head = i
+}
+
+func (c *decisioncache) unlink(i int32) {
+	prev, next := c.nodes[i].prev, c.nodes[i].next
+	if next == i {
+		c.head = -1
+		return
+	}
+	c.nodes[prev].next, c.nodes[next].prev = next, prev
+	if c.head == i {
+		c.head = next
+	}
+}
+
+// directory returns the path of uri up to its last slash
+func directory(uri string) string {
+	if i := strings.IndexByte(uri, '?'); i >= 0 {
+		uri = uri[:i]
+	}
+	return uri[:strings.LastIndexByte(uri, '/')+1]
+}
+
+// uniform reports whether every path under dir matches the same rules of g
+func (g *Group) uniform(dir string) bool {
+	for _, r := range g.rules {
+		literal := r.path
+		if r.pattern != nil {
+			literal = r.path[:strings.IndexAny(r.path, "*$")]
+			if strings.HasPrefix(dir, literal) {
+				return false
+			}
+		}
+		if len(literal) > len(dir) && strings.HasPrefix(literal, dir) {
+			return false
+		}
+	}
+	return true
+}
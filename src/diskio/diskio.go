@@ -0,0 +1,248 @@
+// Package diskio writes files sequentially in large blocks submitted
+// asynchronously, so a writer never waits on the disk while it has a free
+// block to fill. On Linux the blocks go to an io_uring, a batch of them per
+// system call; elsewhere, or when the kernel refuses io_uring, they go to a
+// fixed pool of writers, which bounds the threads held by disk writes to the
+// number of blocks in flight. Readiness APIs such as epoll do not help here:
+// regular files are always ready.
+package diskio
+
+import (
+	"errors"
+	"os"
+)
+
+const (
+	defaultBlock = 1 << 20
+	defaultDepth = 8
+)
+
+// Backend is what the blocks of a Writer are submitted to
+type Backend int
+
+const (
+	Auto    Backend = iota // io_uring when the kernel allows it, Threads otherwise
+	Uring                  // io_uring, failing when unavailable
+	Threads                // a fixed pool of writers
+)
+
+var backends = [...]string{"auto", "uring", "threads"}
+
+func (b Backend) String() string {
+	if int(b) < len(backends) {
+		return backends[b]
+	}
+	return "unknown"
+}
+
+// ParseBackend returns the Backend named name
+func ParseBackend(name string) (Backend, error) {
+	for b, s := range backends {
+		if s == name {
+			return Backend(b), nil
+		}
+	}
+	return Auto, errors.New("diskio: unknown backend " + name)
+}
+
+// Options tune a Writer. Zero values pick the defaults.
+type Options struct {
+	Backend Backend
+	Block   int // bytes per write, 1 MiB by default
+	Depth   int // blocks in flight, 8 by default
+}
+
+// engine writes blocks at their offsets in the background
+type engine interface {
+	// queue adds the write of b at off to the next submission
+	queue(b []byte, off int64)
+	// submit starts the writes queued and waits until at least wait of the
+	// writes in flight are done. It returns the blocks written, and the
+	// first error met.
+	submit(wait int, done [][]byte) ([][]byte, error)
+	close() error
+}
+
+// Writer writes a file from start to end. It is not safe for concurrent use.
+type Writer struct {
+	file     *os.File
+	engine   engine
+	backend  Backend
+	depth    int
+	block    []byte   // being filled
+	spare    [][]byte // written, ready to be filled again
+	offset   int64    // of block in the file
+	inflight int
+	queued   int // blocks queued and not submitted yet
+	err      error
+}
+
+// Create creates or truncates the file at path and returns a Writer to it
+func Create(path string, options Options) (*Writer, error) {
+	if options.Block <= 0 {
+		options.Block = defaultBlock
+	}
+	if options.Depth <= 0 {
+		options.Depth = defaultDepth
+	}
+	file, err := os.OpenFile(path, os.O_WRONLY|os.O_CREATE|os.O_TRUNC, 0o644)
+	if err != nil {
+		return nil, err
+	}
+	w := &Writer{file: file, depth: options.Depth, block: make([]byte, 0, options.Block)}
+	if options.Backend != Threads {
+		ring, err := newUring(file, options.Depth)
+		switch {
+		case err == nil:
+			w.engine, w.backend = ring, Uring
+		case options.Backend == Uring:
+			file.Close()
+			return nil, err
+		}
+	}
+	if w.engine == nil {
+		w.engine, w.backend = newThreadpool(file, options.Depth), Threads
+	}
+	return w, nil
+}
+
+// Backend returns the backend the blocks are submitted to
+func (w *Writer) Backend() Backend {
+	return w.backend
+}
+
+// Write copies p into the blocks, submitting each block once full. It only
+// blocks when every block is in flight.
+func (w *Writer) Write(p []byte) (int, error) {
+	n := len(p)
+	for len(p) > 0 && w.err == nil {
+		k := copy(w.block[len(w.block):cap(w.block)], p)
+		w.block, p = w.block[:len(w.block)+k], p[k:]
+		if len(w.block) == cap(w.block) {
+			w.rotate()
+		}
+	}
+	if w.err != nil {
+		return n - len(p), w.err
+	}
+	return n, nil
+}
+
+// rotate queues the block being filled and takes a free one. Blocks are
+// submitted in batches of half the depth, or when no block is free.
+func (w *Writer) rotate() {
+	w.engine.queue(w.block, w.offset)
+	w.offset += int64(len(w.block))
+	w.inflight++
+	w.queued++
+	switch {
+	case len(w.spare) == 0 && w.inflight == w.depth:
+		w.submit(1)
+	case w.queued >= max(w.depth/2, 1):
+		w.submit(0)
+	}
+	if n := len(w.spare); n > 0 {
+		w.block, w.spare = w.spare[n-1][:0], w.spare[:n-1]
+	} else {
+		w.block = make([]byte, 0, cap(w.block))
+	}
+}
+
+// submit submits the blocks queued and waits for wait of the blocks in
+// flight, returning the error of the engine or of a write
+func (w *Writer) submit(wait int) error {
+	start := len(w.spare)
+	var err error
+	w.spare, err = w.engine.submit(wait, w.spare)
+	w.inflight -= len(w.spare) - start
+	w.queued = 0
+	if w.err == nil {
+		w.err = err
+	}
+	return err
+}
+
+// Close writes what is left, waits for the writes in flight and closes the
+// file. It returns the first error met by a write. When the engine fails
+// without completing any write, the writes left are not waited for.
+func (w *Writer) Close() error {
+	if len(w.block) > 0 && w.err == nil {
+		w.engine.queue(w.block, w.offset)
+		w.offset += int64(len(w.block))
+		w.inflight++
+	}
+	w.block = nil
+	for w.inflight > 0 {
+		inflight := w.inflight
+		if err := w.submit(inflight); err != nil && w.inflight == inflight {
+			break
+		}
+	}
+	w.spare = nil
+	err := w.engine.close()
+	if cerr := w.file.Close(); err == nil {
+		err = cerr
+	}
+	if w.err != nil {
+		return w.err
+	}
+	return err
+}
+
+// threadpool writes blocks with a fixed pool of goroutines, each holding a
+// thread while its write blocks
+type threadpool struct {
+	jobs chan write
+	done chan write
+}
+
+type write struct {
+	b   []byte
+	off int64
+	err error
+}
+
+func newThreadpool(file *os.File, workers int) *threadpool {
+	t := &threadpool{jobs: make(chan write, workers), done: make(chan write, workers)}
+	for i := 0; i < workers; i++ {
+		go func() {
+			for job := range t.jobs {
+				_, job.err = file.WriteAt(job.b, job.off)
+				t.done <- job
+			}
+		}()
+	}
+	return t
+}
+
+// queue starts the write right away: the Writer never has more blocks in
+// flight than there are writers
+func (t *threadpool) queue(b []byte, off int64) {
+	t.jobs <- write{b: b, off: off}
+}
+
+func (t *threadpool) submit(wait int, done [][]byte) ([][]byte, error) {
+	var err error
+	collect := func(job write) {
+		done = append(done, job.b)
+		if err == nil {
+			err = job.err
+		}
+	}
+	for ; wait > 0; wait-- {
+		collect(<-t.done)
+	}
+	for {
+		select {
+		case job := <-t.done:
+			collect(job)
+		default:
+			return done, err
+		}
+	}
+}
+
+func (t *threadpool) close() error {
+	close(t.jobs)
+	return nil
+}
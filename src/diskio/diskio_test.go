@@ -0,0 +1,85 @@
+package diskio
+
+import (
+	"bytes"
+	"errors"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+func TestWriterRoundTrip(t *testing.T) {
+	const block = 4096
+	// Three and a half blocks, the last one partial
+	data := make([]byte, 3*block+block/2)
+	for i := range data {
+		data[i] = byte(i*7 + i/block)
+	}
+	for _, backend := range []Backend{Threads, Uring} {
+		t.Run(backend.String(), func(t *testing.T) {
+			path := filepath.Join(t.TempDir(), "out")
+			w, err := Create(path, Options{Backend: backend, Block: block, Depth: 2})
+			if err != nil {
+				if backend == Uring {
+					t.Skipf("io_uring unavailable: %v", err)
+				}
+				t.Fatal(err)
+			}
+			if w.Backend() != backend {
+				t.Errorf("Backend = %v, want %v", w.Backend(), backend)
+			}
+			// Writes of odd sizes straddle the blocks
+			for rest := data; len(rest) > 0; {
+				n := min(len(rest), 1000)
+				if _, err := w.Write(rest[:n]); err != nil {
+					t.Fatal(err)
+				}
+				rest = rest[n:]
+			}
+			if err := w.Close(); err != nil {
+				t.Fatal(err)
+			}
+			got, err := os.ReadFile(path)
+			if err != nil {
+				t.Fatal(err)
+			}
+			if !bytes.Equal(got, data) {
+				t.Errorf("read back %d bytes differing from the %d written", len(got), len(data))
+			}
+		})
+	}
+}
+
+var errEngine = errors.New("engine down")
+
+// failing is an engine whose submissions fail without completing anything
+type failing struct{}
+
+func (failing) queue(b []byte, off int64) {}
+
+func (failing) submit(wait int, done [][]byte) ([][]byte, error) {
+	return done, errEngine
+}
+
+func (failing) close() error { return nil }
+
+func TestWriterCloseEngineError(t *testing.T) {
+	file, err := os.Create(filepath.Join(t.TempDir(), "out"))
+	if err != nil {
+		t.Fatal(err)
+	}
+	w := &Writer{file: file, engine: failing{}, depth: 2, block: make([]byte, 0, 16)}
+	w.Write(make([]byte, 40))
+
+	closed := make(chan error, 1)
+	go func() { closed <- w.Close() }()
+	select {
+	case err := <-closed:
+		if !errors.Is(err, errEngine) {
+			t.Errorf("Close = %v, want %v", err, errEngine)
+		}
+	case <-time.After(time.Second):
+		t.Fatal("Close kept waiting on a failing engine")
+	}
+}
@@ -0,0 +1,210 @@
+//go:build linux
+
+package diskio
+
+import (
+	"os"
+	"sync/atomic"
+	"syscall"
+	"unsafe"
+)
+
+// System calls and constants of io_uring, the same on every architecture
+const (
+	sysIoUringSetup = 425
+	sysIoUringEnter = 426
+
+	ioringOffSqRing      = 0
+	ioringOffCqRing      = 0x8000000
+	ioringOffSqes        = 0x10000000
+	ioringEnterGetevents = 1
+	ioringOpWrite        = 23 // Linux 5.6
+)
+
+type uringparams struct {
+	sqEntries, cqEntries uint32
+	flags                uint32
+	sqThreadCPU          uint32
+	sqThreadIdle         uint32
+	features             uint32
+	wqFd                 uint32
+	resv                 [3]uint32
+	sqOff                sqringoffsets
+	cqOff                cqringoffsets
+}
+
+type sqringoffsets struct {
+	head, tail, ringMask, ringEntries, flags, dropped, array, resv1 uint32
+	userAddr                                                        uint64
+}
+
+type cqringoffsets struct {
+	head, tail, ringMask, ringEntries, overflow, cqes, flags, resv1 uint32
+	userAddr                                                        uint64
+}
+
+// sqe is a submission queue entry
+type sqe struct {
+	opcode   uint8
+	flags    uint8
+	ioprio   uint16
+	fd       int32
+	off      uint64
+	addr     uint64
+	len      uint32
+	rwFlags  uint32
+	userData uint64
+	_        [3]uint64
+}
+
+// cqe is a completion queue entry
+type cqe struct {
+	userData uint64
+	res      int32
+	flags    uint32
+}
+
+// uring writes blocks through an io_uring. The submission and completion
+// rings are shared with the kernel; user data identifies the slot of the
+// block written.
+type uring struct {
+	file              *os.File
+	fd                int   // of the ring
+	filefd            int32 // of the file written
+	sqmem, cqmem, sqe []byte
+
+	sqTail  *uint32
+	sqMask  uint32
+	sqArray []uint32
+	sqes    []sqe
+	cqHead  *uint32
+	cqTail  *uint32
+	cqMask  uint32
+	cqes    []cqe
+
+	slots  []write // blocks in flight
+	free   []uint64
+	queued uint32
+}
+
+func newUring(file *os.File, depth int) (*uring, error) {
+	var p uringparams
+	fd, _, errno := syscall.Syscall(sysIoUringSetup, uintptr(depth), uintptr(unsafe.Pointer(&p)), 0)
+	if errno != 0 {
+		return nil, os.NewSyscallError("io_uring_setup", errno)
+	}
+	r := &uring{file: file, fd: int(fd), filefd: int32(file.Fd()), slots: make([]write, depth)}
+	mmap := func(off int64, size uint32) ([]byte, error) {
+		mem, err := syscall.Mmap(r.fd, off, int(size), syscall.PROT_READ|syscall.PROT_WRITE, syscall.MAP_SHARED|syscall.MAP_POPULATE)
+		return mem, os.NewSyscallError("mmap", err)
+	}
+	var err error
+	if r.sqmem, err = mmap(ioringOffSqRing, p.sqOff.array+p.sqEntries*4); err != nil {
+		r.close()
+		return nil, err
+	}
+	if r.cqmem, err = mmap(ioringOffCqRing, p.cqOff.cqes+p.cqEntries*uint32(unsafe.Sizeof(cqe{}))); err != nil {
+		r.close()
+		return nil, err
+	}
+	if r.sqe, err = mmap(ioringOffSqes, p.sqEntries*uint32(unsafe.Sizeof(sqe{}))); err != nil {
+		r.close()
+		return nil, err
+	}
+
+	r.sqTail = (*uint32)(unsafe.Pointer(&r.sqmem[p.sqOff.tail]))
+	r.sqMask = *(*uint32)(unsafe.Pointer(&r.sqmem[p.sqOff.ringMask]))
+	r.sqArray = unsafe.Slice((*uint32)(unsafe.Pointer(&r.sqmem[p.sqOff.array])), p.sqEntries)
+	r.sqes = unsafe.Slice((*sqe)(unsafe.Pointer(&r.sqe[0])), p.sqEntries)
+	r.cqHead = (*uint32)(unsafe.Pointer(&r.cqmem[p.cqOff.head]))
+	r.cqTail = (*uint32)(unsafe.Pointer(&r.cqmem[p.cqOff.tail]))
+	r.cqMask = *(*uint32)(unsafe.Pointer(&r.cqmem[p.cqOff.ringMask]))
+	r.cqes = unsafe.Slice((*cqe)(unsafe.Pointer(&r.cqmem[p.cqOff.cqes])), p.cqEntries)
+	for slot := depth - 1; slot >= 0; slot-- {
+		r.free = append(r.free, uint64(slot))
+	}
+	return r, nil
+}
+
+// queue fills a submission entry. The kernel only sees it once submit
+// enters the ring.
+func (r *uring) queue(b []byte, off int64) {
+	slot := r.free[len(r.free)-1]
+	r.free = r.free[:len(r.free)-1]
+	r.slots[slot] = write{b: b, off: off}
+
+	tail := *r.sqTail
+	i := tail & r.sqMask
+	r.sqes[i] = sqe{
+		opcode:   ioringOpWrite,
+		fd:       r.filefd,
+		off:      uint64(off),
+		addr:     uint64(uintptr(unsafe.Pointer(unsafe.SliceData(b)))),
+		len:      uint32(len(b)),
+		userData: slot,
+	}
+	r.sqArray[i] = i
+	atomic.StoreUint32(r.sqTail, tail+1)
+	r.queued++
+}
+
+// submit hands the queued entries to the kernel and waits for completions
+// in the same system call
+func (r *uring) submit(wait int, done [][]byte) ([][]byte, error) {
+	var err error
+	for {
+		flags := uintptr(0)
+		if wait > 0 {
+			flags = ioringEnterGetevents
+		}
+		if r.queued > 0 || wait > 0 {
+			n, _, errno := syscall.Syscall6(sysIoUringEnter, uintptr(r.fd), uintptr(r.queued), uintptr(wait), flags, 0, 0)
+			if errno == syscall.EINTR {
+				continue
+			}
+			if errno != 0 {
+				return done, os.NewSyscallError("io_uring_enter", errno)
+			}
+			r.queued -= uint32(n)
+		}
+
+		head, tail := *r.cqHead, atomic.LoadUint32(r.cqTail)
+		for ; head != tail; head++ {
+			c := r.cqes[head&r.cqMask]
+			w := r.slots[c.userData]
+			r.slots[c.userData] = write{}
+			r.free = append(r.free, c.userData)
+			if werr := r.complete(w, c.res); err == nil {
+				err = werr
+			}
+			done = append(done, w.b)
+			wait--
+		}
+		atomic.StoreUint32(r.cqHead, head)
+		if wait <= 0 && r.queued == 0 {
+			return done, err
+		}
+	}
+}
+
+// complete finishes the write w whose result is res, writing the rest of
+// a short write directly
+func (r *uring) complete(w write, res int32) error {
+	if res < 0 {
+		return os.NewSyscallError("write", syscall.Errno(-res))
+	}
+	if int(res) < len(w.b) {
+		_, err := r.file.WriteAt(w.b[res:], w.off+int64(res))
+		return err
+	}
+	return nil
+}
+
+func (r *uring) close() error {
+	for _, mem := range [][]byte{r.sqmem, r.cqmem, r.sqe} {
+		if mem != nil {
+			syscall.Munmap(mem)
+		}
+	}
+	return syscall.Close(r.fd)
+}
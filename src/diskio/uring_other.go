@@ -0,0 +1,16 @@
+//go:build !linux
+
+package diskio
+
+import (
+	"errors"
+	"os"
+)
+
+type uring struct {
+	threadpool
+}
+
+func newUring(file *os.File, depth int) (*uring, error) {
+	return nil, errors.New("diskio: io_uring needs Linux")
+}
@@ -0,0 +1,20 @@
+package crawler
+
+import (
+	"packages/src/fetcher"
+	"packages/src/simhash"
+)
+
+// SetDuplicateindex makes the crawler fingerprint page text, when its fetcher
+// is a Pagefetcher, and skip the links of pages whose fingerprint is near
+// one already in index. Mirrors and session-ID URLs then stop expanding the
+// frontier.
+func (c *Crawler) SetDuplicateindex(index *simhash.Index) {
+	c.nearDups = index
+}
+
+// duplicate reports whether the text of page nearly duplicates a page
+// fetched before
+func (c *Crawler) duplicate(page *fetcher.Page) bool {
+	return c.nearDups != nil && page.Fingerprint != 0 && !c.nearDups.Insert(page.Fingerprint)
+}
@@ -0,0 +1,53 @@
+package fetcher
+
+import (
+	"context"
+	"fmt"
+	"strings"
+	"testing"
+)
+
+func benchbody(links int) string {
+	var b strings.Builder
+	for i := 0; i < links; i++ {
+		fmt.Fprintf(&b, "<p>Some text of paragraph %d, and a few more words.</p>", i)
+		switch i % 4 {
+		case 0:
+			fmt.Fprintf(&b, `<a href="/section/page-%d.html">link</a>`, i)
+		case 1:
+			fmt.Fprintf(&b, `<a href="page-%d.html?ref=nav">link</a>`, i)
+		case 2:
+			fmt.Fprintf(&b, `<a href="http://other-%d.example.org/">link</a>`, i%16)
+		case 3:
+			fmt.Fprintf(&b, `<a href="../up/%d?a=1&amp;b=2#top">link</a>`, i)
+		}
+	}
+	return b.String()
+}
+
+func BenchmarkParse(b *testing.B) {
+	body := benchbody(100)
+	b.SetBytes(int64(len(body)))
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		links, err := Hrefparser{}.Parse(context.Background(), "http://example.com/dir/index.html", strings.NewReader(body))
+		if err != nil {
+			b.Fatal(err)
+		}
+		Releaselinks(links)
+	}
+}
+
+func BenchmarkParsePage(b *testing.B) {
+	body := benchbody(100)
+	b.SetBytes(int64(len(body)))
+	b.ReportAllocs()
+	for i := 0; i < b.N; i++ {
+		page := NewPage()
+		page.ReadBody(strings.NewReader(body), len(body))
+		if err := (Hrefparser{}).ParsePage(context.Background(), "http://example.com/dir/index.html", page); err != nil {
+			b.Fatal(err)
+		}
+		page.Release()
+	}
+}
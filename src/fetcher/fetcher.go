@@ -1,10 +1,48 @@
 package fetcher
 
 import (
+	"context"
 	"io"
 	"net/url"
+	"sync"
 )
 
+// Parser extracts the links of a page body. It gives up with the error of
+// ctx once ctx is done.
 type Parser interface {
-	Parse(string, io.Reader) ([]*url.URL, error)
+	Parse(context.Context, string, io.Reader) ([]*url.URL, error)
+}
+
+// linkbatches pools link batches behind the pointers sync.Pool needs, and
+// linkholders the pointers of the batches handed out, so recycling a batch
+// allocates nothing
+var (
+	linkbatches = sync.Pool{
+		New: func() any { return new([]*url.URL) },
+	}
+	linkholders = sync.Pool{
+		New: func() any { return new([]*url.URL) },
+	}
+)
+
+// Getlinks returns an empty link batch for a Parser to fill
+func Getlinks() []*url.URL {
+	holder := linkbatches.Get().(*[]*url.URL)
+	links := (*holder)[:0]
+	*holder = nil
+	linkholders.Put(holder)
+	return links
+}
+
+// Releaselinks recycles a batch returned by a Parser once its links have
+// been consumed. The URLs themselves stay valid.
+func Releaselinks(links []*url.URL) {
+	if cap(links) == 0 {
+		return
+	}
+	links = links[:cap(links)]
+	clear(links)
+	holder := linkholders.Get().(*[]*url.URL)
+	*holder = links[:0]
+	linkbatches.Put(holder)
 }
@@ -0,0 +1,166 @@
+package fetcher
+
+import (
+	"bytes"
+	"net/url"
+	"packages/src/arena"
+	"strings"
+)
+
+// Linkfilter drops the links of a page while it is parsed, from the raw
+// href, so rejected links are never resolved nor allocated. It only drops
+// links whose resolved URL would certainly fail it; anything it cannot tell
+// from the href is kept. The zero value keeps every link.
+type Linkfilter struct {
+	Hosts   []string // kept host names, without port; every host when empty
+	Schemes []string // kept schemes; every scheme when empty
+	Deny    []string // extensions of the last path segment dropped, like ".jpg"
+}
+
+// Discard is the reason a Linkfilter dropped a link
+type Discard int
+
+const (
+	DiscardScheme Discard = iota
+	DiscardHost
+	DiscardExtension
+	NumDiscards
+)
+
+func (d Discard) String() string {
+	switch d {
+	case DiscardScheme:
+		return "scheme"
+	case DiscardHost:
+		return "host"
+	case DiscardExtension:
+		return "extension"
+	}
+	return "unknown"
+}
+
+// keeps reports whether the link href passes the filter, and if not why.
+// References without a scheme, or without a host, inherit those of the
+// page, whose own verdict is base.
+func (f *Linkfilter) keeps(base verdict, href []byte) (Discard, bool) {
+	if i := bytes.IndexAny(href, "?#"); i >= 0 {
+		href = href[:i]
+	}
+
+	rest := href
+	if scheme, ok := hrefScheme(href); ok {
+		if len(f.Schemes) > 0 && !foldedIn(scheme, f.Schemes) {
+			return DiscardScheme, false
+		}
+		rest = href[len(scheme)+1:]
+		if !bytes.HasPrefix(rest, []byte("//")) {
+			// An opaque URL such as mailto:, which holds no host
+			if len(f.Hosts) > 0 {
+				return DiscardHost, false
+			}
+			return 0, true
+		}
+	} else if !base.ok && base.reason == DiscardScheme {
+		return DiscardScheme, false
+	}
+
+	if bytes.HasPrefix(rest, []byte("//")) {
+		rest = rest[2:]
+		end := bytes.IndexByte(rest, '/')
+		if end < 0 {
+			end = len(rest)
+		}
+		if host, ok := hrefHost(rest[:end]); ok && len(f.Hosts) > 0 && !in(host, f.Hosts) {
+			return DiscardHost, false
+		}
+		rest = rest[end:]
+	} else if !base.ok {
+		return base.reason, false
+	}
+
+	if len(f.Deny) > 0 {
+		segment := rest[bytes.LastIndexByte(rest, '/')+1:]
+		if dot := bytes.LastIndexByte(segment, '.'); dot > 0 && bytes.IndexByte(segment, '%') < 0 &&
+			foldedIn(segment[dot:], f.Deny) {
+			return DiscardExtension, false
+		}
+	}
+	return 0, true
+}
+
+// verdict is the outcome of a Linkfilter for the page links are found on
+type verdict struct {
+	reason Discard
+	ok     bool
+}
+
+// page returns the verdict of the filter on the scheme and host of base
+func (f *Linkfilter) page(base *url.URL) verdict {
+	switch {
+	case len(f.Schemes) > 0 && !foldedIn([]byte(base.Scheme), f.Schemes):
+		return verdict{DiscardScheme, false}
+	case len(f.Hosts) > 0 && !in([]byte(base.Hostname()), f.Hosts):
+		return verdict{DiscardHost, false}
+	}
+	return verdict{ok: true}
+}
+
+// hrefScheme returns the scheme of href, following the syntax net/url
+// accepts: a letter, then letters, digits, '+', '-' or '.', then a colon
+func hrefScheme(href []byte) ([]byte, bool) {
+	for i, c := range href {
+		switch {
+		case 'a' <= c && c <= 'z' || 'A' <= c && c <= 'Z':
+		case '0' <= c && c <= '9' || c == '+' || c == '-' || c == '.':
+			if i == 0 {
+				return nil, false
+			}
+		case c == ':':
+			return href[:i], i > 0
+		default:
+			return nil, false
+		}
+	}
+	return nil, false
+}
+
+// hrefHost returns the host name of an authority, without user info, port
+// or IPv6 brackets, as url.URL.Hostname does. It fails for escaped hosts,
+// which net/url unescapes.
+func hrefHost(authority []byte) ([]byte, bool) {
+	if at := bytes.LastIndexByte(authority, '@'); at >= 0 {
+		authority = authority[at+1:]
+	}
+	if bytes.IndexByte(authority, '%') >= 0 {
+		return nil, false
+	}
+	if len(authority) > 0 && authority[0] == '[' {
+		end := bytes.IndexByte(authority, ']')
+		if end < 0 {
+			return nil, false
+		}
+		return authority[1:end], true
+	}
+	if colon := bytes.LastIndexByte(authority, ':'); colon >= 0 {
+		authority = authority[:colon]
+	}
+	return authority, true
+}
+
+func in(s []byte, set []string) bool {
+	for _, v := range set {
+		if string(s) == v {
+			return true
+		}
+	}
+	return false
+}
+
+func foldedIn(s []byte, set []string) bool {
+	for _, v := range set {
+		if strings.EqualFold(arena.View(s), v) {
+			return true
+		}
+	}
+	return false
+}
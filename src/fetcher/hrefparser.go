@@ -0,0 +1,341 @@
+package fetcher
+
+import (
+	"bytes"
+	"context"
+	"html"
+	"io"
+	"net/url"
+	"packages/src/arena"
+	"packages/src/pool"
+	"packages/src/simhash"
+	"strings"
+)
+
+const scancheck = 1024 // tags scanned between cancellation checks
+
+// Hrefparser extracts the href targets of anchor tags from an HTML body
+type Hrefparser struct{}
+
+// Parse returns the absolute links of the <a href> tags found in body,
+// resolved against link and stripped of their fragment. The body is read
+// into a pooled buffer and the links come in a batch from Getlinks.
+func (p Hrefparser) Parse(ctx context.Context, link string, body io.Reader) ([]*url.URL, error) {
+	base, err := url.Parse(link)
+	if err != nil {
+		return nil, err
+	}
+	buf, err := pool.ReadAll(body, 0)
+	defer pool.Put(buf)
+	if err != nil {
+		return nil, err
+	}
+
+	links := Getlinks()
+	err = scan(ctx, *buf, nil, func(href []byte) {
+		if abs, ok := resolve(base, href); ok {
+			links = append(links, abs)
+		}
+	})
+	return links, err
+}
+
+// ParsePage is Parse over the body read into page, filling page with the
+// links found. Links of the common shapes
+// (absolute http(s), root-relative and plain relative paths) are built
+// without allocating: their strings point into the body, kept with the page,
+// or into the page arena. When page.Simhash is set, the word shingles of the
+// text are fingerprinted in the same pass. Links dropped by page.Filter are
+// counted without being resolved.
+func (p Hrefparser) ParsePage(ctx context.Context, link string, page *Page) error {
+	base, err := url.Parse(link)
+	if err != nil {
+		return err
+	}
+
+	var (
+		hasher   simhash.Hasher
+		shingler *simhash.Shingler
+	)
+	if page.Simhash {
+		shingler = &simhash.Shingler{Hasher: &hasher}
+	}
+	filter := page.Filter
+	var inherited verdict
+	if filter != nil {
+		inherited = filter.page(base)
+	}
+	err = scan(ctx, page.Body(), shingler, func(href []byte) {
+		if filter != nil {
+			if reason, ok := filter.keeps(inherited, href); !ok {
+				page.Discarded[reason]++
+				return
+			}
+		}
+		if abs, ok := resolveInto(page, base, href); ok {
+			page.Links = append(page.Links, abs)
+		} else if abs, ok := resolve(base, href); ok {
+			page.Links = append(page.Links, abs)
+		}
+	})
+	if hasher.Features() > 0 {
+		page.Fingerprint = hasher.Sum()
+	}
+	return err
+}
+
+// scan calls found with the href of every anchor tag in data, and feeds the
+// words of the text to shingler when it is not nil. It checks ctx every
+// scancheck tags, returning its error once done.
+func scan(ctx context.Context, data []byte, shingler *simhash.Shingler, found func(href []byte)) error {
+	for tags := 1; ; tags++ {
+		if tags%scancheck == 0 && ctx.Err() != nil {
+			return ctx.Err()
+		}
+		i := bytes.IndexByte(data, '<')
+		if i < 0 {
+			words(data, shingler)
+			return nil
+		}
+		words(data[:i], shingler)
+		data = data[i+1:]
+		end := bytes.IndexByte(data, '>')
+		if end < 0 {
+			return nil
+		}
+		tag := data[:end]
+		data = data[end+1:]
+
+		if raw := rawTextElement(tag); raw != "" {
+			// Skip script and style bodies, they are neither text nor links
+			if i := indexFold(data, "</"+raw); i >= 0 {
+				data = data[i:]
+			}
+			continue
+		}
+
+		if len(tag) < 2 || (tag[0] != 'a' && tag[0] != 'A') || !isSpace(tag[1]) {
+			continue
+		}
+		if href, ok := attribute(tag[2:], "href"); ok {
+			found(unescape(href))
+		}
+	}
+}
+
+// unescape decodes the character references of an attribute value, so that
+// href="/a?x=1&amp;y=2" links to /a?x=1&y=2. Values without any are
+// returned as they are, without allocating.
+func unescape(value []byte) []byte {
+	if bytes.IndexByte(value, '&') < 0 {
+		return value
+	}
+	return []byte(html.UnescapeString(string(value)))
+}
+
+// resolve parses href and resolves it against base with net/url
+func resolve(base *url.URL, href []byte) (*url.URL, bool) {
+	ref, err := url.Parse(string(href))
+	if err != nil {
+		return nil, false
+	}
+	abs := base.ResolveReference(ref)
+	abs.Fragment, abs.RawFragment = "", ""
+	return abs, true
+}
+
+// resolveInto resolves the common shapes of href against base without
+// allocating, building the URL in page. It returns false for anything
+// needing the full rules of net/url: other schemes, escapes, dot segments,
+// protocol-relative links, empty references.
+func resolveInto(page *Page, base *url.URL, href []byte) (*url.URL, bool) {
+	if i := bytes.IndexByte(href, '#'); i >= 0 {
+		href = href[:i]
+	}
+	if len(href) == 0 || !Plainurl(base) {
+		return nil, false
+	}
+
+	var scheme, host string
+	switch {
+	case bytes.HasPrefix(href, []byte("http://")):
+		scheme, href = "http", href[len("http://"):]
+	case bytes.HasPrefix(href, []byte("https://")):
+		scheme, href = "https", href[len("https://"):]
+	case bytes.HasPrefix(href, []byte("//")):
+		return nil, false
+	}
+	relative := scheme == ""
+	if !relative {
+		end := bytes.IndexAny(href, "/?")
+		if end < 0 {
+			end = len(href)
+		}
+		if !plainHost(href[:end]) {
+			return nil, false
+		}
+		host, href = arena.View(href[:end]), href[end:]
+	}
+
+	rawpath, rawquery, hasQuery := bytes.Cut(href, []byte("?"))
+	if !plain(rawpath, &pathchars) || !plain(rawquery, &querychars) ||
+		(hasQuery && len(rawquery) == 0) || dotSegments(rawpath) ||
+		bytes.HasPrefix(rawpath, []byte("//")) {
+		return nil, false
+	}
+	path := arena.View(rawpath)
+	if relative {
+		if dotSegments(base.Path) || strings.HasPrefix(base.Path, "//") {
+			return nil, false
+		}
+		scheme, host = base.Scheme, base.Host
+		switch {
+		case path == "":
+			// A query-only reference keeps the base path
+			path = base.Path
+		case path[0] != '/':
+			// A relative reference, which cannot hold a scheme
+			if strings.IndexByte(path, ':') >= 0 {
+				return nil, false
+			}
+			dir := base.Path[:strings.LastIndexByte(base.Path, '/')+1]
+			if dir == "" {
+				dir = "/"
+			}
+			path = page.Arena.String(dir, path)
+		}
+	}
+
+	u := page.url()
+	u.Scheme, u.Host, u.Path, u.RawQuery = scheme, host, path, arena.View(rawquery)
+	return u, true
+}
+
+// plainHost reports whether host is a lowercase name with an optional
+// numeric port, which net/url keeps as is
+func plainHost(host []byte) bool {
+	name, port, _ := bytes.Cut(host, []byte(":"))
+	if len(name) == 0 || !plain(name, &hostchars) {
+		return false
+	}
+	for _, c := range port {
+		if c < '0' || c > '9' {
+			return false
+		}
+	}
+	return true
+}
+
+// dotSegments reports whether path holds "." or ".." segments
+func dotSegments[T string | []byte](path T) bool {
+	start := 0
+	for i := 0; i <= len(path); i++ {
+		if i < len(path) && path[i] != '/' {
+			continue
+		}
+		if n := i - start; (n == 1 || n == 2) && path[start] == '.' && path[i-1] == '.' {
+			return true
+		}
+		start = i + 1
+	}
+	return false
+}
+
+// attribute returns the value of the named attribute in the body of a tag
+func attribute(tag []byte, name string) ([]byte, bool) {
+	for len(tag) > 0 {
+		for len(tag) > 0 && isSpace(tag[0]) {
+			tag = tag[1:]
+		}
+		i := 0
+		for i < len(tag) && tag[i] != '=' && !isSpace(tag[i]) {
+			i++
+		}
+		key := tag[:i]
+		tag = tag[i:]
+		for len(tag) > 0 && isSpace(tag[0]) {
+			tag = tag[1:]
+		}
+		if len(tag) == 0 || tag[0] != '=' {
+			continue
+		}
+		tag = tag[1:]
+		for len(tag) > 0 && isSpace(tag[0]) {
+			tag = tag[1:]
+		}
+
+		var value []byte
+		if len(tag) > 0 && (tag[0] == '"' || tag[0] == '\'') {
+			end := bytes.IndexByte(tag[1:], tag[0])
+			if end < 0 {
+				return nil, false
+			}
+			value, tag = tag[1:end+1], tag[end+2:]
+		} else {
+			j := 0
+			for j < len(tag) && !isSpace(tag[j]) {
+				j++
+			}
+			value, tag = tag[:j], tag[j:]
+		}
+		if string(bytes.ToLower(key)) == name {
+			return bytes.TrimSpace(value), true
+		}
+	}
+	return nil, false
+}
+
+func rawTextElement(tag []byte) string {
+	for _, name := range []string{"script", "style"} {
+		if len(tag) >= len(name) && bytes.EqualFold(tag[:len(name)], []byte(name)) &&
+			(len(tag) == len(name) || isSpace(tag[len(name)])) {
+			return name
+		}
+	}
+	return ""
+}
+
+// indexFold returns the index of the first case-insensitive match of s
+func indexFold(data []byte, s string) int {
+	for i := 0; i+len(s) <= len(data); i++ {
+		j := bytes.IndexByte(data[i:], '<')
+		if j < 0 {
+			return -1
+		}
+		i += j
+		if i+len(s) <= len(data) && bytes.EqualFold(data[i:i+len(s)], []byte(s)) {
+			return i
+		}
+	}
+	return -1
+}
+
+// words feeds the FNV-1a hash of each lowercased word of text to shingler
+func words(text []byte, shingler *simhash.Shingler) {
+	if shingler == nil {
+		return
+	}
+	const offset, prime = 14695981039346656037, 1099511628211
+	h, n := uint64(offset), 0
+	for _, c := range text {
+		if c >= 'A' && c <= 'Z' {
+			c += 'a' - 'A'
+		}
+		if (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80 {
+			h = (h ^ uint64(c)) * prime
+			n++
+			continue
+		}
+		if n > 0 {
+			shingler.Word(h)
+			h, n = offset, 0
+		}
+	}
+	if n > 0 {
+		shingler.Word(h)
+	}
+}
+
+func isSpace(c byte) bool {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'
+}
@@ -0,0 +1,138 @@
+package fetcher
+
+import (
+	"context"
+	"fmt"
+	"html"
+	"net/url"
+	"strings"
+	"testing"
+)
+
+var hrefbases = []string{
+	"http://example.com",
+	"http://example.com/",
+	"https://example.com/dir/page.html?q=1",
+	"http://example.com:8080/a/b/",
+	"http://example.com/a/./b/../c",
+}
+
+var hrefs = []string{
+	// absolute and root-relative
+	"http://other.com/x",
+	"https://other.com",
+	"HTTP://Other.com/Path",
+	"http://other.com:81/p?a=b",
+	"/root",
+	"/root?x=1",
+	"//cdn.example.com/lib.js",
+	// relative
+	"page",
+	"sub/page.html",
+	"?only=query",
+	"#fragment",
+	"page#fragment",
+	"",
+	// dot segments
+	"./here",
+	"../up",
+	"../../../../above",
+	"/a/b/../c",
+	"a/./b/",
+	".",
+	"..",
+	// escapes and entities
+	"/a%20b",
+	"/caf%C3%A9",
+	"/a?x=1&amp;y=2",
+	"/a?x=1&#38;y=2",
+	"/&lt;tag&gt;",
+	"page?q=a&amp;amp;b",
+	// other schemes and malformed
+	"mailto:someone@example.com",
+	"javascript:void(0)",
+	"a:b",
+	"http://[::1",
+	"/%zz",
+	"http://exa mple.com/",
+	"/path with space",
+}
+
+// resolved returns what net/url makes of href found in a page at base, the
+// empty string when it rejects it
+func resolved(base, href string) string {
+	b, err := url.Parse(base)
+	if err != nil {
+		return ""
+	}
+	ref, err := url.Parse(html.UnescapeString(href))
+	if err != nil {
+		return ""
+	}
+	abs := b.ResolveReference(ref)
+	abs.Fragment, abs.RawFragment = "", ""
+	return abs.String()
+}
+
+func TestHrefparserMatchesURL(t *testing.T) {
+	var p Hrefparser
+	for _, base := range hrefbases {
+		for _, href := range hrefs {
+			body := fmt.Sprintf(`<p>text</p><a href="%s">link</a>`, href)
+			want := resolved(base, href)
+
+			links, err := p.Parse(context.Background(), base, strings.NewReader(body))
+			if err != nil {
+				t.Fatalf("Parse(%q, %q): %v", base, href, err)
+			}
+			page := NewPage()
+			if err := page.ReadBody(strings.NewReader(body), 0); err != nil {
+				t.Fatal(err)
+			}
+			if err := p.ParsePage(context.Background(), base, page); err != nil {
+				t.Fatalf("ParsePage(%q, %q): %v", base, href, err)
+			}
+
+			for name, got := range map[string][]*url.URL{"Parse": links, "ParsePage": page.Links} {
+				switch {
+				case want == "" && len(got) != 0:
+					t.Errorf("%s(%q, %q) = %v, want no link", name, base, href, got)
+				case want != "" && (len(got) != 1 || got[0].String() != want):
+					t.Errorf("%s(%q, %q) = %v, want %s", name, base, href, got, want)
+				}
+			}
+			Releaselinks(links)
+			page.Release()
+		}
+	}
+}
+
+func TestHrefparserAttributes(t *testing.T) {
+	body := `<A HREF='/single'>` + `<a title="x" href=/bare>` + `<a  href = "/spaced" >` +
+		`<area href="/area">` + `<abbr href="/abbr">` + `<a name="nohref">` +
+		`<script>"<a href='/script'>"</script>` + `<a href="/last">`
+	links, err := Hrefparser{}.Parse(context.Background(), "http://example.com/", strings.NewReader(body))
+	if err != nil {
+		t.Fatal(err)
+	}
+	var got []string
+	for _, l := range links {
+		got = append(got, l.Path)
+	}
+	want := []string{"/single", "/bare", "/spaced", "/last"}
+	if strings.Join(got, " ") != strings.Join(want, " ") {
+		t.Errorf("links = %v, want %v", got, want)
+	}
+}
+
+func TestReleaselinksAllocs(t *testing.T) {
+	links := Getlinks()
+	links = append(links, &url.URL{Path: "/a"})
+	Releaselinks(links)
+	allocs := testing.AllocsPerRun(100, func() {
+		Releaselinks(append(Getlinks(), nil))
+	})
+	if allocs > 0 {
+		t.Errorf("%.1f allocations to get and release a batch, want none", allocs)
+	}
+}
@@ -0,0 +1,161 @@
+package fetcher
+
+import (
+	"bytes"
+	"context"
+	"io"
+	"net/http"
+	"net/url"
+	"packages/src/profiling"
+	"strings"
+	"time"
+)
+
+// Httpfetcher fetches pages over HTTP and extracts their links with a Parser
+type Httpfetcher struct {
+	client    *http.Client
+	parser    Parser
+	userAgent string
+	metrics   *Fetchmetrics
+	labelled  bool
+	retry     Retrypolicy
+	maxBody   int64
+}
+
+const defaultmaxbody = 8 << 20 // bytes of a body read at most
+
+// NewHttpfetcher creates a new Httpfetcher struct
+func NewHttpfetcher(client *http.Client, parser Parser, userAgent string) *Httpfetcher {
+	return &Httpfetcher{
+		client:    client,
+		parser:    parser,
+		userAgent: userAgent,
+		metrics:   &Fetchmetrics{},
+		retry:     DefaultRetrypolicy(),
+		maxBody:   defaultmaxbody,
+	}
+}
+
+// SetMaxBody truncates the bodies read to n bytes, 8 MiB when n is zero or
+// less. The links of a truncated page are those of its first n bytes.
+func (f *Httpfetcher) SetMaxBody(n int64) {
+	if n <= 0 {
+		n = defaultmaxbody
+	}
+	f.maxBody = n
+}
+
+// SetMetrics makes the fetcher record its activity in m
+func (f *Httpfetcher) SetMetrics(m *Fetchmetrics) {
+	f.metrics = m
+}
+
+// SetProfileLabels tags parsing with the pprof labels of the host and the
+// parse phase
+func (f *Httpfetcher) SetProfileLabels(on bool) {
+	f.labelled = on
+}
+
+// Fetch issues a GET for link, hedged when the retry policy or a paced
+// context says so, and
+// returns the time taken to receive the response headers. The caller must
+// close the response body. Cancelling ctx aborts the request, including the
+// read of the body.
+func (f *Httpfetcher) Fetch(ctx context.Context, link string) (time.Duration, *http.Response, error) {
+	start := time.Now()
+	resp, err := f.hedged(ctx, link)
+	return time.Since(start), resp, err
+}
+
+// Fetchlinks fetches link and parses the links out of an HTML body. The
+// returned duration covers the whole fetch including the body.
+func (f *Httpfetcher) Fetchlinks(ctx context.Context, link string) (time.Duration, []*url.URL, error) {
+	var links []*url.URL
+	d, err := f.get(ctx, link, func(body io.Reader, _ int64) (err error) {
+		f.parsing(link, func() {
+			Releaselinks(links) // from a failed try
+			links, err = f.parser.Parse(ctx, link, body)
+		})
+		return err
+	})
+	return d, links, err
+}
+
+// Fetchpage is Fetchlinks filling page: Fetchbody followed by Parsepage
+func (f *Httpfetcher) Fetchpage(ctx context.Context, link string, page *Page) (time.Duration, error) {
+	start := time.Now()
+	if _, err := f.Fetchbody(ctx, link, page); err != nil {
+		return time.Since(start), err
+	}
+	err := f.Parsepage(ctx, link, page)
+	return time.Since(start), err
+}
+
+// Fetchbody fetches link and reads an HTML body into page, leaving the body
+// empty for other content types. The returned duration covers the download.
+func (f *Httpfetcher) Fetchbody(ctx context.Context, link string, page *Page) (time.Duration, error) {
+	return f.get(ctx, link, func(body io.Reader, size int64) error {
+		return page.ReadBody(body, int(max(size, 0)))
+	})
+}
+
+// Parsepage parses the body read into page by Fetchbody, filling the page
+// with its links. Parsers that are not Pageparsers only provide the links.
+func (f *Httpfetcher) Parsepage(ctx context.Context, link string, page *Page) (err error) {
+	if page.Body() == nil {
+		return nil
+	}
+	f.parsing(link, func() {
+		if pageparser, ok := f.parser.(Pageparser); ok {
+			err = pageparser.ParsePage(ctx, link, page)
+			return
+		}
+		var links []*url.URL
+		links, err = f.parser.Parse(ctx, link, bytes.NewReader(page.Body()))
+		page.Links = append(page.Links, links...)
+		Releaselinks(links)
+	})
+	return err
+}
+
+// get fetches link and hands an HTML body and its announced length, -1 if
+// unknown, to read. Transient failures, including those reading the body,
+// are retried following the retry policy.
+func (f *Httpfetcher) get(ctx context.Context, link string, read func(io.Reader, int64) error) (time.Duration, error) {
+	start := time.Now()
+	err := f.retrying(ctx, func() error {
+		_, resp, err := f.Fetch(ctx, link)
+		if err != nil {
+			return err
+		}
+		defer resp.Body.Close()
+		f.metrics.status(resp.StatusCode)
+
+		if resp.StatusCode < 200 || resp.StatusCode > 299 {
+			return newHttperror(link, resp)
+		}
+		if ct := resp.Header.Get("Content-Type"); ct != "" && !strings.HasPrefix(ct, "text/html") {
+			return nil
+		}
+		return f.metrics.read(resp.Body, func(body io.Reader) error {
+			return read(io.LimitReader(body, f.maxBody), min(resp.ContentLength, f.maxBody))
+		})
+	})
+	return time.Since(start), err
+}
+
+// parsing runs parse, recording its duration and tagging it with the
+// profiling labels of the link's host when enabled
+func (f *Httpfetcher) parsing(link string, parse func()) {
+	start := time.Now()
+	if f.labelled {
+		host := strings.TrimPrefix(strings.TrimPrefix(link, "http://"), "https://")
+		if i := strings.IndexAny(host, "/?#"); i >= 0 {
+			host = host[:i]
+		}
+		profiling.Do(host, "parse", parse)
+	} else {
+		parse()
+	}
+	f.metrics.parseTime.ObserveDuration(time.Since(start))
+}
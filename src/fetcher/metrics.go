@@ -0,0 +1,61 @@
+package fetcher
+
+import (
+	"io"
+	"packages/src/metrics"
+	"strconv"
+)
+
+// Fetchmetrics instruments an Httpfetcher. The zero value records nothing.
+type Fetchmetrics struct {
+	bytes     *metrics.Counter
+	statuses  *metrics.Countervec
+	parseTime *metrics.Histogram
+	retries   *metrics.Counter
+	hedges    *metrics.Counter
+	hedgeWins *metrics.Counter
+}
+
+// NewFetchmetrics registers the fetcher metrics in registry
+func NewFetchmetrics(registry *metrics.Registry) *Fetchmetrics {
+	return &Fetchmetrics{
+		bytes: registry.Counter("fetcher_body_bytes_total",
+			"Bytes of page bodies read."),
+		statuses: registry.Countervec("fetcher_responses_total",
+			"Responses received by status code.", "code"),
+		parseTime: registry.Histogram("fetcher_parse_duration_seconds",
+			"Time spent parsing links out of page bodies.", metrics.DefaultBuckets),
+		retries: registry.Counter("fetcher_retries_total",
+			"Fetches tried again after a transient failure."),
+		hedges: registry.Counter("fetcher_hedged_requests_total",
+			"Second requests sent as the first was slow to answer."),
+		hedgeWins: registry.Counter("fetcher_hedge_wins_total",
+			"Hedged requests answering before the request they duplicated."),
+	}
+}
+
+func (m *Fetchmetrics) status(code int) {
+	if m.statuses != nil {
+		m.statuses.With(strconv.Itoa(code)).Inc()
+	}
+}
+
+// countingreader counts the bytes read through it
+type countingreader struct {
+	r io.Reader
+	n uint64
+}
+
+func (c *countingreader) Read(p []byte) (int, error) {
+	n, err := c.r.Read(p)
+	c.n += uint64(n)
+	return n, err
+}
+
+// read runs read over body, recording the bytes read
+func (m *Fetchmetrics) read(body io.Reader, read func(io.Reader) error) error {
+	counted := &countingreader{r: body}
+	err := read(counted)
+	m.bytes.Add(counted.n)
+	return err
+}
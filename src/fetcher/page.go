@@ -0,0 +1,159 @@
+package fetcher
+
+import (
+	"context"
+	"io"
+	"net/url"
+	"packages/src/arena"
+	"packages/src/pool"
+	"strings"
+	"sync"
+)
+
+const urlslab = 64 // URL structs per slab
+
+// Page is what a Pageparser extracts from one fetched page. The links, and
+// the strings they hold, may point into the page body and arena: they stay
+// valid until Release and must go through CloneURL to outlive it.
+type Page struct {
+	Links       []*url.URL
+	Fingerprint uint64 // SimHash of the text when Simhash is set
+	Simhash     bool   // asks the parser to fingerprint the text
+
+	// Filter, when not nil, drops links before they are resolved, counting
+	// them in Discarded by reason
+	Filter    *Linkfilter
+	Discarded [NumDiscards]int
+
+	// Arena is scratch space released with the page
+	Arena arena.Arena
+
+	body  *[]byte
+	slabs [][]url.URL
+	nurls int
+}
+
+// Pageparser is a Parser that can parse the body read into a Page, filling
+// it and allocating from its arena
+type Pageparser interface {
+	Parser
+	ParsePage(context.Context, string, *Page) error
+}
+
+var pages = sync.Pool{
+	New: func() any { return new(Page) },
+}
+
+// NewPage returns an empty Page
+func NewPage() *Page {
+	return pages.Get().(*Page)
+}
+
+// url returns a zeroed URL living as long as the page
+func (p *Page) url() *url.URL {
+	slab, i := p.nurls/urlslab, p.nurls%urlslab
+	if slab == len(p.slabs) {
+		p.slabs = append(p.slabs, make([]url.URL, urlslab))
+	}
+	p.nurls++
+	return &p.slabs[slab][i]
+}
+
+// ReadBody reads body to its end into a pooled buffer living as long as the
+// page, so body must be bounded: Httpfetcher limits it to SetMaxBody. hint
+// is the expected size, or zero when unknown.
+func (p *Page) ReadBody(body io.Reader, hint int) error {
+	buf, err := pool.ReadAll(body, hint)
+	if p.body != nil {
+		pool.Put(p.body)
+	}
+	p.body = buf
+	return err
+}
+
+// Body returns the body read into the page, nil if none was
+func (p *Page) Body() []byte {
+	if p.body == nil {
+		return nil
+	}
+	return *p.body
+}
+
+// Release recycles the page, its body, arena and links in one step
+func (p *Page) Release() {
+	for i := 0; i*urlslab < p.nurls; i++ {
+		clear(p.slabs[i])
+	}
+	clear(p.Links)
+	p.Links, p.nurls = p.Links[:0], 0
+	p.Fingerprint, p.Simhash = 0, false
+	p.Filter, p.Discarded = nil, [NumDiscards]int{}
+	p.Arena.Reset()
+	if p.body != nil {
+		pool.Put(p.body)
+		p.body = nil
+	}
+	pages.Put(p)
+}
+
+// CloneURL returns a copy of u owning its strings
+func CloneURL(u *url.URL) *url.URL {
+	c := *u
+	c.Scheme = strings.Clone(u.Scheme)
+	c.Opaque = strings.Clone(u.Opaque)
+	c.Host = strings.Clone(u.Host)
+	c.Path = strings.Clone(u.Path)
+	c.RawPath = strings.Clone(u.RawPath)
+	c.RawQuery = strings.Clone(u.RawQuery)
+	c.Fragment = strings.Clone(u.Fragment)
+	c.RawFragment = strings.Clone(u.RawFragment)
+	if u.User != nil {
+		if password, ok := u.User.Password(); ok {
+			c.User = url.UserPassword(u.User.Username(), password)
+		} else {
+			c.User = url.User(u.User.Username())
+		}
+	}
+	return &c
+}
+
+// Plainurl reports whether u.String() is exactly the concatenation of its
+// scheme, "://", host, path and, when not empty, "?" and raw query. Such
+// URLs can be serialized without going through url.URL.String.
+func Plainurl(u *url.URL) bool {
+	return u.Scheme != "" && u.Opaque == "" && u.User == nil && u.RawPath == "" &&
+		!u.ForceQuery && u.Fragment == "" && plain(u.Path, &pathchars) &&
+		(u.Path == "" || u.Path[0] == '/')
+}
+
+// Character classes that url.URL keeps verbatim
+var pathchars, querychars, hostchars [256]bool
+
+func init() {
+	for c := 'a'; c <= 'z'; c++ {
+		pathchars[c], pathchars[c-'a'+'A'] = true, true
+		hostchars[c] = true
+	}
+	for c := '0'; c <= '9'; c++ {
+		pathchars[c], hostchars[c] = true, true
+	}
+	for _, c := range "-._~$&+,/:;=@" {
+		pathchars[c] = true
+	}
+	querychars = pathchars
+	for _, c := range "?%!'()*" {
+		querychars[c] = true
+	}
+	for _, c := range "-.:" {
+		hostchars[c] = true
+	}
+}
+
+func plain[T string | []byte](s T, class *[256]bool) bool {
+	for i := 0; i < len(s); i++ {
+		if !class[s[i]] {
+			return false
+		}
+	}
+	return true
+}
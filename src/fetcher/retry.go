@@ -0,0 +1,248 @@
+package fetcher
+
+import (
+	"context"
+	"errors"
+	"fmt"
+	"io"
+	"math/rand"
+	"net/http"
+	"net/url"
+	"strconv"
+	"time"
+)
+
+// Retrypolicy decides how an Httpfetcher retries transient failures and
+// hedges slow requests. Every request is an idempotent GET, so repeating or
+// duplicating one is safe.
+type Retrypolicy struct {
+	Attempts   int           // tries per fetch including the first, 1 disables retries
+	Backoff    time.Duration // delay before the first retry, doubled after each
+	MaxBackoff time.Duration // longest delay between tries, Retry-After included
+	// Hedge sends a second request when the first has not answered within
+	// this delay, keeping the first response. Zero disables hedging.
+	Hedge time.Duration
+}
+
+// DefaultRetrypolicy tries three times from a 50ms backoff, without hedging
+func DefaultRetrypolicy() Retrypolicy {
+	return Retrypolicy{Attempts: 3, Backoff: 50 * time.Millisecond, MaxBackoff: 2 * time.Second}
+}
+
+// backoff returns the jittered delay before the retry following attempt,
+// at least retryAfter when the server asked for it
+func (p Retrypolicy) backoff(attempt int, retryAfter time.Duration) time.Duration {
+	// Doubled one step at a time up to MaxBackoff, as shifting Backoff by
+	// the attempt overflows
+	d := min(p.Backoff, p.MaxBackoff)
+	for n := 1; n < attempt && d > 0 && d < p.MaxBackoff; n++ {
+		if d > p.MaxBackoff/2 {
+			d = p.MaxBackoff
+		} else {
+			d *= 2
+		}
+	}
+	if d > 1 {
+		// Equal jitter: half fixed so retries keep backing off, half random
+		// so the clients of a failing host do not come back in lockstep
+		d = d/2 + time.Duration(rand.Int63n(int64(d/2)+1))
+	}
+	return min(max(d, retryAfter), p.MaxBackoff)
+}
+
+// Delay returns the jittered delay before retrying a fetch that failed with
+// err on attempt, at least the Retry-After of an Httperror
+func (p Retrypolicy) Delay(attempt int, err error) time.Duration {
+	var retryAfter time.Duration
+	if httperr := (*Httperror)(nil); errors.As(err, &httperr) {
+		retryAfter = httperr.RetryAfter
+	}
+	return p.backoff(attempt, retryAfter)
+}
+
+type pacedkey struct{}
+
+// Paced marks the fetches made with ctx as paced by a caller that retries
+// them itself once its own limits allow another request, such as a crawler
+// holding to crawl delays. An Httpfetcher tries them once, and hedges them
+// after hedge, zero for never, whatever its retry policy.
+func Paced(ctx context.Context, hedge time.Duration) context.Context {
+	return context.WithValue(ctx, pacedkey{}, hedge)
+}
+
+// paced returns the hedge delay of a context marked by Paced, and whether
+// it is
+func paced(ctx context.Context) (time.Duration, bool) {
+	hedge, ok := ctx.Value(pacedkey{}).(time.Duration)
+	return hedge, ok
+}
+
+// Httperror reports a response whose status is not 2xx
+type Httperror struct {
+	URL        string
+	Status     string
+	Code       int
+	RetryAfter time.Duration // zero unless given in seconds by the server
+}
+
+func (e *Httperror) Error() string {
+	return fmt.Sprintf("fetch %s: %s", e.URL, e.Status)
+}
+
+// Temporary reports whether the status may differ on a later attempt
+func (e *Httperror) Temporary() bool {
+	return e.Code == http.StatusTooManyRequests ||
+		(e.Code >= 500 && e.Code != http.StatusNotImplemented)
+}
+
+func newHttperror(link string, resp *http.Response) *Httperror {
+	e := &Httperror{URL: link, Status: resp.Status, Code: resp.StatusCode}
+	if secs, err := strconv.Atoi(resp.Header.Get("Retry-After")); err == nil && secs > 0 {
+		e.RetryAfter = time.Duration(secs) * time.Second
+	}
+	return e
+}
+
+// Transient reports whether err, returned by a fetch, may not happen again:
+// network failures, timeouts and temporary statuses. Cancellations and
+// malformed URLs are not.
+func Transient(err error) bool {
+	var httperr *Httperror
+	var urlerr *url.Error
+	switch {
+	case err == nil, errors.Is(err, context.Canceled):
+		return false
+	case errors.As(err, &httperr):
+		return httperr.Temporary()
+	case errors.As(err, &urlerr) && urlerr.Op == "parse":
+		return false
+	}
+	return true
+}
+
+// SetRetrypolicy replaces the default retry policy of the fetcher
+func (f *Httpfetcher) SetRetrypolicy(p Retrypolicy) {
+	p.Attempts = max(p.Attempts, 1)
+	f.retry = p
+}
+
+// retrying runs attempt until it succeeds, fails for good or the tries of
+// the policy are exhausted, sleeping the backoff in between. Paced fetches
+// are tried once.
+func (f *Httpfetcher) retrying(ctx context.Context, attempt func() error) error {
+	attempts := f.retry.Attempts
+	if _, ok := paced(ctx); ok {
+		attempts = 1
+	}
+	for n := 1; ; n++ {
+		err := attempt()
+		if err == nil || n >= attempts || !Transient(err) || ctx.Err() != nil {
+			return err
+		}
+		f.metrics.retries.Inc()
+
+		timer := time.NewTimer(f.retry.Delay(n, err))
+		select {
+		case <-timer.C:
+		case <-ctx.Done():
+			timer.Stop()
+			return err
+		}
+	}
+}
+
+// hedged sends a GET for link, and a second one if the first has not
+// answered within the hedge delay. The first successful response wins and
+// the other request is cancelled. Paced fetches use the hedge delay of
+// their context.
+func (f *Httpfetcher) hedged(ctx context.Context, link string) (*http.Response, error) {
+	delay := f.retry.Hedge
+	if hedge, ok := paced(ctx); ok {
+		delay = hedge
+	}
+	if delay <= 0 {
+		return f.request(ctx, link)
+	}
+
+	type answer struct {
+		resp *http.Response
+		err  error
+		try  int
+	}
+	answers := make(chan answer, 2)
+	var cancels []context.CancelFunc
+	send := func() {
+		tryctx, cancel := context.WithCancel(ctx)
+		try := len(cancels)
+		cancels = append(cancels, cancel)
+		go func() {
+			resp, err := f.request(tryctx, link)
+			answers <- answer{resp, err, try}
+		}()
+	}
+
+	send()
+	timer := time.NewTimer(delay)
+	defer timer.Stop()
+	hedge := timer.C
+	var failure error
+	for pending := 1; pending > 0; {
+		select {
+		case <-hedge:
+			f.metrics.hedges.Inc()
+			send()
+			hedge, pending = nil, pending+1
+		case a := <-answers:
+			pending--
+			if a.err != nil {
+				failure = a.err
+				continue
+			}
+			for try, cancel := range cancels {
+				if try != a.try {
+					cancel()
+				}
+			}
+			go func(n int) {
+				for ; n > 0; n-- {
+					if lost := <-answers; lost.resp != nil {
+						lost.resp.Body.Close()
+					}
+				}
+			}(pending)
+			if a.try > 0 {
+				f.metrics.hedgeWins.Inc()
+			}
+			a.resp.Body = &cancelbody{ReadCloser: a.resp.Body, cancel: cancels[a.try]}
+			return a.resp, nil
+		}
+	}
+	// Every request failed, before the hedge was due or after
+	for _, cancel := range cancels {
+		cancel()
+	}
+	return nil, failure
+}
+
+// cancelbody releases the context of a hedged request once its body is
+// closed
+type cancelbody struct {
+	io.ReadCloser
+	cancel context.CancelFunc
+}
+
+func (b *cancelbody) Close() error {
+	err := b.ReadCloser.Close()
+	b.cancel()
+	return err
+}
+
+// request issues a single GET for link
+func (f *Httpfetcher) request(ctx context.Context, link string) (*http.Response, error) {
+	req, err := http.NewRequestWithContext(ctx, http.MethodGet, link, nil)
+	if err != nil {
+		return nil, err
+	}
+	req.Header.Set("User-Agent", f.userAgent)
+	return f.client.Do(req)
+}
@@ -0,0 +1,28 @@
+package fetcher
+
+import (
+	"math"
+	"testing"
+	"time"
+)
+
+func TestBackoffBounded(t *testing.T) {
+	policies := []Retrypolicy{
+		{Attempts: 100, Backoff: 50 * time.Millisecond, MaxBackoff: 2 * time.Second},
+		{Attempts: 100, Backoff: time.Second, MaxBackoff: math.MaxInt64},
+	}
+	for _, p := range policies {
+		last := time.Duration(0)
+		for attempt := 1; attempt < p.Attempts; attempt++ {
+			d := p.backoff(attempt, 0)
+			if d <= 0 || d > p.MaxBackoff {
+				t.Fatalf("%+v: backoff(%d) = %v, want within (0, %v]", p, attempt, d, p.MaxBackoff)
+			}
+			// Jitter keeps at least half of the doubled delay
+			if d < last/2 {
+				t.Fatalf("%+v: backoff(%d) = %v fell below half of the previous %v", p, attempt, d, last)
+			}
+			last = d
+		}
+	}
+}
@@ -0,0 +1,124 @@
+package fetcher
+
+import (
+	"bufio"
+	"bytes"
+	"compress/gzip"
+	"context"
+	"encoding/xml"
+	"errors"
+	"io"
+	"strings"
+	"time"
+)
+
+// Limits of the sitemaps protocol for a single file
+const (
+	maxsitemapentries = 50000
+	maxsitemapbytes   = 50 << 20
+)
+
+// ErrSitemapTooLarge is returned once a sitemap exceeds the limits of the
+// protocol. The entries seen until then have been delivered.
+var ErrSitemapTooLarge = errors.New("sitemap exceeds 50000 entries or 50MB")
+
+// Sitemapentry is a location listed by a sitemap: a page, or another
+// sitemap for the entries of a sitemap index
+type Sitemapentry struct {
+	Loc     string
+	Lastmod time.Time // zero when not given
+	Index   bool      // Loc is a sitemap listed by a sitemap index
+}
+
+// ParseSitemap streams the entries of a sitemap or sitemap index to visit as
+// they are decoded, without holding the document in memory. Gzipped bodies
+// are inflated. It stops at the first error of visit or of ctx.
+func ParseSitemap(ctx context.Context, body io.Reader, visit func(Sitemapentry) error) error {
+	buffered := bufio.NewReader(body)
+	if magic, _ := buffered.Peek(2); len(magic) == 2 && magic[0] == 0x1f && magic[1] == 0x8b {
+		inflated, err := gzip.NewReader(buffered)
+		if err != nil {
+			return err
+		}
+		defer inflated.Close()
+		body = inflated
+	} else {
+		body = buffered
+	}
+	limited := &io.LimitedReader{R: body, N: maxsitemapbytes + 1}
+
+	decoder := xml.NewDecoder(limited)
+	var (
+		entry   Sitemapentry
+		inEntry bool
+		field   *bytes.Buffer
+		loc     bytes.Buffer
+		lastmod bytes.Buffer
+		count   int
+	)
+	for {
+		token, err := decoder.RawToken()
+		if err == io.EOF {
+			return nil
+		}
+		if err != nil {
+			if limited.N <= 0 {
+				return ErrSitemapTooLarge
+			}
+			return err
+		}
+
+		switch t := token.(type) {
+		case xml.StartElement:
+			switch t.Name.Local {
+			case "url", "sitemap":
+				entry, inEntry = Sitemapentry{Index: t.Name.Local == "sitemap"}, true
+				loc.Reset()
+				lastmod.Reset()
+			case "loc":
+				field = &loc
+			case "lastmod":
+				field = &lastmod
+			}
+		case xml.CharData:
+			if inEntry && field != nil {
+				field.Write(t)
+			}
+		case xml.EndElement:
+			switch t.Name.Local {
+			case "loc", "lastmod":
+				field = nil
+			case "url", "sitemap":
+				if !inEntry {
+					continue
+				}
+				inEntry = false
+				entry.Loc = strings.TrimSpace(loc.String())
+				if entry.Loc == "" {
+					continue
+				}
+				entry.Lastmod = parseLastmod(strings.TrimSpace(lastmod.String()))
+				if count++; count > maxsitemapentries {
+					return ErrSitemapTooLarge
+				}
+				if count%1024 == 0 && ctx.Err() != nil {
+					return ctx.Err()
+				}
+				if err := visit(entry); err != nil {
+					return err
+				}
+			}
+		}
+	}
+}
+
+// parseLastmod parses the W3C datetime of a <lastmod>, returning the zero
+// time when it is missing or malformed
+func parseLastmod(s string) time.Time {
+	for _, layout := range []string{time.RFC3339, "2006-01-02T15:04Z07:00", "2006-01-02"} {
+		if t, err := time.Parse(layout, s); err == nil {
+			return t
+		}
+	}
+	return time.Time{}
+}
@@ -0,0 +1,750 @@
+package crawler
+
+import (
+	"net/url"
+	"packages/src/metrics"
+	"sync"
+	"time"
+)
+
+// Entry is an URL waiting in the frontier
+type Entry struct {
+	URL        *url.URL
+	Depth      int
+	Discovered time.Time
+	Modified   time.Time // last change listed by a sitemap, zero when unknown
+
+	tries int // failed fetches, kept while the entry is in memory
+
+	key string // cache key of URL, kept once the entry was ranked
+}
+
+// fifo is a slice-backed queue with amortized O(1) push and pop
+type fifo[T any] struct {
+	items []T
+	head  int
+}
+
+func (q *fifo[T]) push(v T) {
+	if q.head > 0 && q.head == len(q.items) {
+		q.items, q.head = q.items[:0], 0
+	}
+	q.items = append(q.items, v)
+}
+
+func (q *fifo[T]) pop() T {
+	var zero T
+	v := q.items[q.head]
+	q.items[q.head] = zero
+	q.head++
+	if q.head >= 1024 && q.head*2 >= len(q.items) {
+		n := copy(q.items, q.items[q.head:])
+		clear(q.items[n:])
+		q.items, q.head = q.items[:n], 0
+	}
+	return v
+}
+
+// unpop puts v back at the head of the queue
+func (q *fifo[T]) unpop(v T) {
+	if q.head > 0 {
+		q.head--
+		q.items[q.head] = v
+		return
+	}
+	var zero T
+	q.items = append(q.items, zero)
+	copy(q.items[1:], q.items)
+	q.items[0] = v
+}
+
+func (q *fifo[T]) len() int {
+	return len(q.items) - q.head
+}
+
+// hostqueue holds the entries of one host in one bucket per depth, so the
+// shallowest entry is always served first. With a budget, the most valuable
+// entries wait in a heap instead and are served before the buckets.
+type hostqueue struct {
+	host    string
+	group   *hostgroup
+	buckets []fifo[Entry]
+	lowest  int
+	size    int       // entries in the heap and the buckets
+	busy    bool      // an entry of the host is being fetched
+	parked  time.Time // the host is left out of the rotation until then
+	inturn  bool      // the host waits for its turn in its group
+	depth   *metrics.Gauge
+
+	// Under a budget the most valuable entries are ranked in top
+	limit  int              // entries ranked, zero without a budget
+	top    []ranked         // max-heap by value
+	ranks  map[string]int32 // index in top by cache key
+	popped ranked           // the entry handed out last
+	handed int              // entries handed out
+	cited  int              // links from other hosts
+	// bucket and entries of it ranked again by the promotes so far
+	promoting, promoted int
+	// priority of the entries ranked, from SetPriority
+	priority func(key string) float64
+
+	// Beyond the head limit entries are spilled: they gather in tail and
+	// are written to disk a block at a time.
+	tail     []Entry
+	spilled  fifo[*spillblock]
+	nspilled int
+	loading  bool
+}
+
+// hostgroup is the unit of politeness of the frontier: a single host, or
+// the hosts merged by Group. One entry of a group is handed out at a time,
+// its hosts taking turns.
+type hostgroup struct {
+	key     string
+	turn    fifo[*hostqueue]
+	busy    int       // entries of the group being fetched
+	parked  time.Time // the group is left out of the rotation until then
+	inready bool      // the group waits in the rotation
+}
+
+// idle reports whether the group is neither fetched nor parked
+func (g *hostgroup) idle(now time.Time) bool {
+	return g.busy == 0 && !now.Before(g.parked)
+}
+
+// next returns the host whose turn it is, dropping the hosts left with
+// nothing to hand out, parked or moved to another group
+func (g *hostgroup) next(now time.Time) *hostqueue {
+	for g.turn.len() > 0 {
+		h := g.turn.pop()
+		if h.group != g {
+			continue
+		}
+		h.inturn = false
+		if h.size > 0 && !now.Before(h.parked) {
+			return h
+		}
+	}
+	return nil
+}
+
+func (h *hostqueue) push(e Entry) {
+	h.size++
+	if h.limit > 0 {
+		var left bool
+		if e, left = h.rank(e, h.limit); !left {
+			return
+		}
+	}
+	h.buckets[e.Depth].push(e)
+	if e.Depth < h.lowest {
+		h.lowest = e.Depth
+	}
+}
+
+// unpop puts e back as the next entry of the host
+func (h *hostqueue) unpop(e Entry) {
+	h.size++
+	if h.limit > 0 && h.popped.entry.URL == e.URL {
+		h.popped.entry = e
+		if len(h.top) >= h.limit {
+			h.bucket(h.remove(h.weakest()).entry)
+		}
+		h.insert(h.popped)
+		h.popped = ranked{}
+		return
+	}
+	h.buckets[e.Depth].unpop(e)
+	if e.Depth < h.lowest {
+		h.lowest = e.Depth
+	}
+}
+
+func (h *hostqueue) pop() Entry {
+	h.size--
+	if len(h.top) > 0 {
+		h.popped = h.remove(0)
+		// The shallowest entry waiting takes its place
+		if h.size > len(h.top) {
+			e := h.unbucket()
+			h.rank(e, h.limit)
+		}
+		return h.popped.entry
+	}
+	return h.unbucket()
+}
+
+// bucket puts e back at the head of its bucket
+func (h *hostqueue) bucket(e Entry) {
+	h.buckets[e.Depth].unpop(e)
+	if e.Depth < h.lowest {
+		h.lowest = e.Depth
+	}
+}
+
+func (h *hostqueue) unbucket() Entry {
+	for h.buckets[h.lowest].len() == 0 {
+		h.lowest++
+	}
+	return h.buckets[h.lowest].pop()
+}
+
+// Frontier schedules queued URLs breadth-first within each host, or most
+// valuable first under a Budget, and round-robin across host groups, a
+// group being a single host unless Group merges hosts, the hosts of a group
+// taking turns. A group is handed to one worker at a time, so it re-enters
+// the rotation only once its fetch is done, and not before the end of a
+// Park. URLs deeper than the maximum depth are pruned when pushed.
+//
+// With spilling enabled, each host keeps at most headLimit entries in memory
+// and appends the rest to compressed on-disk segments, which are read back
+// in the background once the head drains to half the limit.
+type Frontier struct {
+	mutex    sync.Mutex
+	cond     *sync.Cond
+	maxDepth int
+	hosts    map[string]*hostqueue
+	groups   map[string]*hostgroup
+	ready    fifo[*hostgroup]
+	queued   int
+	inflight int
+	pruned   uint64
+	lost     uint64
+	stopped  bool
+	paused   time.Time // no entry is handed out until then
+	// keepalive makes Pop wait for pushes even when the frontier is idle
+	keepalive bool
+
+	spill     *spillstore
+	headLimit int
+	budget    *Budget
+	priority  func(key string) float64
+	depth     *metrics.Gaugevec // entries queued per host
+
+	// extracting counts the Extract calls waiting for blocks being read back
+	extracting int
+}
+
+// NewFrontier creates a new Frontier struct
+func NewFrontier(maxDepth int) *Frontier {
+	f := &Frontier{
+		maxDepth: maxDepth,
+		hosts:    make(map[string]*hostqueue),
+		groups:   make(map[string]*hostgroup),
+	}
+	f.cond = sync.NewCond(&f.mutex)
+	return f
+}
+
+// Push queues link found at depth. It returns false when the link is
+// deeper than the maximum depth.
+func (f *Frontier) Push(link *url.URL, depth int) bool {
+	if depth > f.maxDepth {
+		f.mutex.Lock()
+		f.pruned++
+		f.mutex.Unlock()
+		return false
+	}
+	e := Entry{URL: link, Depth: depth, Discovered: time.Now()}
+
+	f.mutex.Lock()
+	f.push(e)
+	f.mutex.Unlock()
+	return true
+}
+
+// Pushbatch queues links found at depth in one go, in order. It returns
+// the number queued, zero when depth exceeds the maximum depth.
+func (f *Frontier) Pushbatch(links []*url.URL, depth int) int {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	if depth > f.maxDepth {
+		f.pruned += uint64(len(links))
+		return 0
+	}
+	now := time.Now()
+	for _, link := range links {
+		f.push(Entry{URL: link, Depth: depth, Discovered: now})
+	}
+	return len(links)
+}
+
+// Pushmodified is Pushbatch for links whose last change is known,
+// modified[i] being the one of links[i]
+func (f *Frontier) Pushmodified(links []*url.URL, modified []time.Time, depth int) int {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	if depth > f.maxDepth {
+		f.pruned += uint64(len(links))
+		return 0
+	}
+	now := time.Now()
+	for i, link := range links {
+		f.push(Entry{URL: link, Depth: depth, Discovered: now, Modified: modified[i]})
+	}
+	return len(links)
+}
+
+// Restore queues entries saved by an earlier crawl, keeping their depth and
+// discovery time. It returns the number queued, entries deeper than the
+// maximum depth being pruned.
+func (f *Frontier) Restore(entries []Entry) int {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	n := 0
+	for _, e := range entries {
+		if e.Depth > f.maxDepth {
+			f.pruned++
+			continue
+		}
+		f.push(e)
+		n++
+	}
+	return n
+}
+
+func (f *Frontier) push(e Entry) {
+	h := f.hostqueue(e.URL.Host)
+	f.queued++
+	h.depth.Add(1)
+	if f.spill != nil && (h.nspilled > 0 || h.size >= f.headLimit) {
+		f.spillEntry(h, e)
+		return
+	}
+	h.push(e)
+	if h.size == 1 {
+		f.wake(h, time.Now())
+	}
+}
+
+// hostqueue returns the queue of host, created in a group of its own
+func (f *Frontier) hostqueue(host string) *hostqueue {
+	h, ok := f.hosts[host]
+	if !ok {
+		h = &hostqueue{host: host, buckets: make([]fifo[Entry], f.maxDepth+1)}
+		if f.budget != nil {
+			h.limit, h.priority = f.budget.Top, f.priority
+		}
+		h.group = f.group(host)
+		h.depth = f.depth.With(host)
+		f.hosts[host] = h
+	}
+	return h
+}
+
+func (f *Frontier) group(key string) *hostgroup {
+	g, ok := f.groups[key]
+	if !ok {
+		g = &hostgroup{key: key}
+		f.groups[key] = g
+	}
+	return g
+}
+
+// wake puts h in the turn of its group when it has entries and is not
+// parked, and the group in the rotation when it may hand them out
+func (f *Frontier) wake(h *hostqueue, now time.Time) {
+	if h.size == 0 || now.Before(h.parked) {
+		return
+	}
+	if !h.inturn {
+		h.inturn = true
+		h.group.turn.push(h)
+	}
+	f.wakegroup(h.group, now)
+}
+
+func (f *Frontier) wakegroup(g *hostgroup, now time.Time) {
+	if g.inready || g.turn.len() == 0 || !g.idle(now) {
+		return
+	}
+	g.inready = true
+	f.ready.push(g)
+	f.cond.Signal()
+}
+
+// Group merges host into the group key, whose hosts take turns and are
+// handed out one entry at a time. A host moves to a group once, before its
+// entries are spread across several.
+func (f *Frontier) Group(host, key string) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+
+	h := f.hostqueue(host)
+	old := h.group
+	if old.key == key {
+		return
+	}
+	if old.key == host {
+		delete(f.groups, host)
+	}
+	g := f.group(key)
+	h.group, h.inturn = g, false
+	if h.busy {
+		old.busy--
+		g.busy++
+	}
+	now := time.Now()
+	f.wakegroup(old, now)
+	f.wake(h, now)
+}
+
+// Hold keeps the frontier from being reported drained, as if an entry was
+// in flight, while work that may push entries runs outside of it. Each Hold
+// is ended by a call to Unhold.
+func (f *Frontier) Hold() {
+	f.mutex.Lock()
+	f.inflight++
+	f.mutex.Unlock()
+}
+
+// Unhold ends a Hold
+func (f *Frontier) Unhold() {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	if f.inflight--; f.inflight == 0 && f.queued == 0 {
+		f.cond.Broadcast()
+	}
+}
+
+// Pop blocks until an entry of an idle host is available and marks its host
+// busy until Done is called. It returns false once the frontier is stopped
+// or nothing is queued or in flight.
+func (f *Frontier) Pop() (Entry, bool) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+
+	var h *hostqueue
+	for h == nil {
+		for (f.ready.len() == 0 || time.Now().Before(f.paused)) &&
+			(f.queued > 0 || f.inflight > 0 || f.keepalive) && !f.stopped {
+			f.cond.Wait()
+		}
+		if f.stopped || f.ready.len() == 0 {
+			return Entry{}, false
+		}
+		// Groups emptied by Extract or parked while waiting in the
+		// rotation are dropped from it here, and woken up again later
+		g := f.ready.pop()
+		g.inready = false
+		if now := time.Now(); g.idle(now) {
+			h = g.next(now)
+		}
+	}
+	h.busy = true
+	h.handed++
+	h.group.busy++
+	f.queued--
+	f.inflight++
+	h.depth.Add(-1)
+	e := h.pop()
+	if h.size > 0 {
+		// To the back of the turn of its group
+		h.inturn = true
+		h.group.turn.push(h)
+	}
+	if h.nspilled > 0 && !h.loading && h.size <= f.headLimit/2 {
+		f.refill(h)
+	}
+	return e, true
+}
+
+// Done returns the group of the host of e to the rotation
+func (f *Frontier) Done(e Entry) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+
+	h := f.hosts[e.URL.Host]
+	h.busy = false
+	h.group.busy--
+	f.inflight--
+	f.wake(h, time.Now())
+	f.wakegroup(h.group, time.Now())
+	if f.inflight == 0 && f.queued == 0 {
+		f.cond.Broadcast()
+	}
+}
+
+// Defer hands back e, popped but not fetched, as the next entry of its
+// host, which is parked for d
+func (f *Frontier) Defer(e Entry, d time.Duration) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+
+	h := f.hosts[e.URL.Host]
+	h.unpop(e)
+	h.handed--
+	h.busy = false
+	h.group.busy--
+	f.queued++
+	f.inflight--
+	h.depth.Add(1)
+	if d > 0 {
+		f.park(h, d)
+	}
+	f.wake(h, time.Now())
+	f.wakegroup(h.group, time.Now())
+}
+
+// Pause stops handing out entries for d, whatever their host. Pausing
+// again extends the pause.
+func (f *Frontier) Pause(d time.Duration) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+
+	until := time.Now().Add(d)
+	if until.Before(f.paused) {
+		return
+	}
+	f.paused = until
+	time.AfterFunc(d, func() {
+		// Under the mutex, so the broadcast cannot slip between the
+		// pause check of a Pop and its wait
+		f.mutex.Lock()
+		defer f.mutex.Unlock()
+		f.cond.Broadcast()
+	})
+}
+
+// Park keeps host out of the rotation for d, leaving its entries queued.
+// Parking a host again extends the pause.
+func (f *Frontier) Park(host string, d time.Duration) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+
+	if h, ok := f.hosts[host]; ok {
+		f.park(h, d)
+	}
+}
+
+func (f *Frontier) park(h *hostqueue, d time.Duration) {
+	until := time.Now().Add(d)
+	if until.Before(h.parked) {
+		return
+	}
+	h.parked = until
+	time.AfterFunc(d, func() {
+		f.mutex.Lock()
+		defer f.mutex.Unlock()
+		f.wake(h, time.Now())
+	})
+}
+
+// Parkgroup keeps the group of host out of the rotation for d, along with
+// every host merged into it
+func (f *Frontier) Parkgroup(host string, d time.Duration) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+
+	h, ok := f.hosts[host]
+	if !ok {
+		return
+	}
+	g := h.group
+	until := time.Now().Add(d)
+	if until.Before(g.parked) {
+		return
+	}
+	g.parked = until
+	time.AfterFunc(d, func() {
+		f.mutex.Lock()
+		defer f.mutex.Unlock()
+		f.wakegroup(g, time.Now())
+	})
+}
+
+// EnableSpill makes the frontier keep at most headLimit entries per host in
+// memory and spill the rest to segment files in a new directory under dir.
+func (f *Frontier) EnableSpill(dir string, headLimit int) error {
+	store, err := newSpillstore(dir, defaultspillsegmentsize)
+	if err != nil {
+		return err
+	}
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	f.spill = store
+	f.headLimit = max(headLimit, 1)
+	return nil
+}
+
+// Close removes the spill segments
+func (f *Frontier) Close() error {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	if f.spill == nil {
+		return nil
+	}
+	return f.spill.close()
+}
+
+func (f *Frontier) spillEntry(h *hostqueue, e Entry) {
+	h.tail = append(h.tail, e)
+	h.nspilled++
+	if len(h.tail) < spillblocksize {
+		return
+	}
+	if b, err := f.spill.write(h.tail); err == nil {
+		h.spilled.push(b)
+		h.tail = h.tail[:0]
+		return
+	}
+	// The disk is unavailable, keep the entries in memory
+	f.unspillTail(h)
+}
+
+func (f *Frontier) unspillTail(h *hostqueue) {
+	for _, e := range h.tail {
+		h.push(e)
+	}
+	h.nspilled -= len(h.tail)
+	h.tail = h.tail[:0]
+}
+
+// refill moves the next spilled entries of h back to its head, reading the
+// oldest block from disk in the background
+func (f *Frontier) refill(h *hostqueue) {
+	if h.spilled.len() == 0 {
+		f.unspillTail(h)
+		return
+	}
+	b := h.spilled.pop()
+	h.loading = true
+
+	go func() {
+		entries, err := f.spill.read(b)
+
+		f.mutex.Lock()
+		defer f.mutex.Unlock()
+		f.spill.release(b)
+		h.loading = false
+		if f.extracting > 0 {
+			f.cond.Broadcast()
+		}
+		h.nspilled -= b.count
+		if err != nil || len(entries) < b.count {
+			f.queued -= b.count - len(entries)
+			f.lost += uint64(b.count - len(entries))
+			h.depth.Add(-int64(b.count - len(entries)))
+		}
+
+		for _, e := range entries {
+			h.push(e)
+		}
+		if h.nspilled > 0 && h.size <= f.headLimit/2 {
+			f.refill(h)
+		}
+		f.wake(h, time.Now())
+		if f.queued == 0 && f.inflight == 0 {
+			f.cond.Broadcast()
+		}
+	}()
+}
+
+// SetKeepalive makes Pop block on an idle frontier until more entries are
+// pushed or the frontier is stopped
+func (f *Frontier) SetKeepalive(on bool) {
+	f.mutex.Lock()
+	f.keepalive = on
+	f.mutex.Unlock()
+	f.cond.Broadcast()
+}
+
+// Idle reports whether nothing is queued or in flight
+func (f *Frontier) Idle() bool {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	return f.queued == 0 && f.inflight == 0
+}
+
+// Extract removes and returns the queued entries of every host for which
+// keep returns false. Spilled entries are read back synchronously, once the
+// blocks being read back in the background are pushed to their host.
+func (f *Frontier) Extract(keep func(host string) bool) []Entry {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+
+	f.extracting++
+	for f.loading(keep) {
+		f.cond.Wait()
+	}
+	f.extracting--
+
+	var entries []Entry
+	for host, h := range f.hosts {
+		if keep(host) || h.size+h.nspilled == 0 {
+			continue
+		}
+		removed := h.size + len(h.tail)
+		for h.size > 0 {
+			entries = append(entries, h.pop())
+		}
+		for h.spilled.len() > 0 {
+			b := h.spilled.pop()
+			spilled, _ := f.spill.read(b)
+			f.spill.release(b)
+			entries = append(entries, spilled...)
+			h.nspilled -= b.count
+			f.lost += uint64(b.count - len(spilled))
+			removed += b.count
+		}
+		entries = append(entries, h.tail...)
+		h.nspilled -= len(h.tail)
+		h.tail = h.tail[:0]
+		f.queued -= removed
+		h.depth.Add(-int64(removed))
+	}
+	if f.queued == 0 && f.inflight == 0 {
+		f.cond.Broadcast()
+	}
+	return entries
+}
+
+// SetMetrics makes the frontier report the entries queued per host in depth
+func (f *Frontier) SetMetrics(depth *metrics.Gaugevec) {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	f.depth = depth
+	for host, h := range f.hosts {
+		h.depth = depth.With(host)
+	}
+}
+
+// loading reports whether a host for which keep returns false is reading a
+// spilled block back
+func (f *Frontier) loading(keep func(host string) bool) bool {
+	for host, h := range f.hosts {
+		if h.loading && !keep(host) {
+			return true
+		}
+	}
+	return false
+}
+
+// Stop wakes every blocked Pop and makes further calls return false
+func (f *Frontier) Stop() {
+	f.mutex.Lock()
+	f.stopped = true
+	f.mutex.Unlock()
+	f.cond.Broadcast()
+}
+
+// Len returns the number of queued entries
+func (f *Frontier) Len() int {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	return f.queued
+}
+
+// Lost returns the number of spilled URLs that could not be read back
+func (f *Frontier) Lost() uint64 {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	return f.lost
+}
+
+// Pruned returns the number of URLs dropped for exceeding the maximum depth
+func (f *Frontier) Pruned() uint64 {
+	f.mutex.Lock()
+	defer f.mutex.Unlock()
+	return f.pruned
+}
@@ -0,0 +1,204 @@
+package crawler
+
+import (
+	"fmt"
+	"sort"
+	"testing"
+	"time"
+)
+
+// pop pops an entry, failing the test when none comes within a second
+func pop(t *testing.T, f *Frontier) Entry {
+	t.Helper()
+	popped := make(chan Entry, 1)
+	go func() {
+		if e, ok := f.Pop(); ok {
+			popped <- e
+		}
+		close(popped)
+	}()
+	select {
+	case e, ok := <-popped:
+		if !ok {
+			t.Fatal("Pop returned false")
+		}
+		return e
+	case <-time.After(time.Second):
+		t.Fatal("Pop blocked")
+	}
+	return Entry{}
+}
+
+func TestFrontierPopOrder(t *testing.T) {
+	f := NewFrontier(3)
+	f.Push(mustURL(t, "http://a.com/deep"), 2)
+	f.Push(mustURL(t, "http://a.com/shallow"), 1)
+	f.Push(mustURL(t, "http://b.com/1"), 1)
+	if f.Push(mustURL(t, "http://a.com/toodeep"), 4) {
+		t.Error("Push beyond the maximum depth queued the link")
+	}
+	if f.Len() != 3 || f.Pruned() != 1 {
+		t.Fatalf("Len = %d, Pruned = %d, want 3 and 1", f.Len(), f.Pruned())
+	}
+
+	// Hosts take turns, the shallowest entry of each first
+	var got []string
+	for i := 0; i < 3; i++ {
+		e := pop(t, f)
+		got = append(got, e.URL.String())
+		f.Done(e)
+	}
+	want := []string{"http://a.com/shallow", "http://b.com/1", "http://a.com/deep"}
+	if fmt.Sprint(got) != fmt.Sprint(want) {
+		t.Errorf("popped %v, want %v", got, want)
+	}
+	if _, ok := f.Pop(); ok {
+		t.Error("Pop on an idle frontier returned an entry")
+	}
+}
+
+func TestFrontierBusyHost(t *testing.T) {
+	f := NewFrontier(1)
+	f.Push(mustURL(t, "http://a.com/1"), 0)
+	f.Push(mustURL(t, "http://a.com/2"), 0)
+	first := pop(t, f)
+
+	// The host is busy until Done, so the next Pop waits
+	popped := make(chan Entry)
+	go func() {
+		e, _ := f.Pop()
+		popped <- e
+	}()
+	select {
+	case e := <-popped:
+		t.Fatalf("Pop handed out %v while its host was busy", e.URL)
+	case <-time.After(20 * time.Millisecond):
+	}
+	f.Done(first)
+	select {
+	case e := <-popped:
+		if e.URL.Path != "/2" {
+			t.Errorf("popped %v, want /2", e.URL)
+		}
+		f.Done(e)
+	case <-time.After(time.Second):
+		t.Fatal("Done did not wake Pop")
+	}
+}
+
+func TestFrontierStop(t *testing.T) {
+	f := NewFrontier(1)
+	f.SetKeepalive(true)
+	done := make(chan bool)
+	go func() {
+		_, ok := f.Pop()
+		done <- ok
+	}()
+	time.Sleep(10 * time.Millisecond)
+	f.Stop()
+	select {
+	case ok := <-done:
+		if ok {
+			t.Error("Pop returned an entry after Stop")
+		}
+	case <-time.After(time.Second):
+		t.Fatal("Stop did not wake Pop")
+	}
+}
+
+func TestFrontierDefer(t *testing.T) {
+	f := NewFrontier(1)
+	f.Push(mustURL(t, "http://a.com/1"), 0)
+	f.Push(mustURL(t, "http://a.com/2"), 0)
+	f.Push(mustURL(t, "http://b.com/1"), 0)
+
+	e := pop(t, f)
+	if e.URL.String() != "http://a.com/1" {
+		t.Fatalf("popped %v, want http://a.com/1", e.URL)
+	}
+	// Handed back, it is the next entry of its host, after b.com parked
+	// a.com for a while
+	f.Defer(e, 50*time.Millisecond)
+	if f.Len() != 3 {
+		t.Errorf("Len = %d after Defer, want 3", f.Len())
+	}
+	start := time.Now()
+	b := pop(t, f)
+	if b.URL.Host != "b.com" {
+		t.Errorf("popped %v while a.com was parked", b.URL)
+	}
+	f.Done(b)
+	again := pop(t, f)
+	if again.URL.String() != "http://a.com/1" {
+		t.Errorf("popped %v after Defer, want http://a.com/1", again.URL)
+	}
+	if elapsed := time.Since(start); elapsed < 40*time.Millisecond {
+		t.Errorf("a.com handed out after %v, parked for 50ms", elapsed)
+	}
+	f.Done(again)
+}
+
+func extracted(entries []Entry) []string {
+	var links []string
+	for _, e := range entries {
+		links = append(links, e.URL.String())
+	}
+	sort.Strings(links)
+	return links
+}
+
+func TestFrontierExtract(t *testing.T) {
+	f := NewFrontier(2)
+	for i := 0; i < 3; i++ {
+		f.Push(mustURL(t, fmt.Sprintf("http://a.com/%d", i)), 1)
+		f.Push(mustURL(t, fmt.Sprintf("http://b.com/%d", i)), 1)
+	}
+	entries := f.Extract(func(host string) bool { return host == "a.com" })
+	want := []string{"http://b.com/0", "http://b.com/1", "http://b.com/2"}
+	if got := extracted(entries); fmt.Sprint(got) != fmt.Sprint(want) {
+		t.Errorf("extracted %v, want %v", got, want)
+	}
+	if f.Len() != 3 {
+		t.Errorf("Len = %d after Extract, want 3", f.Len())
+	}
+	for i := 0; i < 3; i++ {
+		e := pop(t, f)
+		if e.URL.Host != "a.com" {
+			t.Errorf("popped %v after its host was extracted", e.URL)
+		}
+		f.Done(e)
+	}
+}
+
+func TestFrontierExtractSpilled(t *testing.T) {
+	f := NewFrontier(1)
+	if err := f.EnableSpill(t.TempDir(), 8); err != nil {
+		t.Fatal(err)
+	}
+	defer f.Close()
+	const n = 3*spillblocksize + 10
+	for i := 0; i < n; i++ {
+		f.Push(mustURL(t, fmt.Sprintf("http://a.com/%d", i)), 0)
+	}
+	// Pop a few so a block is being read back while extracting
+	for i := 0; i < 5; i++ {
+		f.Done(pop(t, f))
+	}
+	entries := f.Extract(func(string) bool { return false })
+	if len(entries) != n-5 {
+		t.Errorf("extracted %d entries, want %d", len(entries), n-5)
+	}
+	seen := make(map[string]bool)
+	for _, e := range entries {
+		if seen[e.URL.Path] {
+			t.Errorf("%v extracted twice", e.URL)
+		}
+		seen[e.URL.Path] = true
+	}
+	if f.Len() != 0 || f.Lost() != 0 {
+		t.Errorf("Len = %d, Lost = %d after Extract, want 0", f.Len(), f.Lost())
+	}
+	if _, ok := f.Pop(); ok {
+		t.Error("Pop returned an entry after everything was extracted")
+	}
+}
@@ -0,0 +1,63 @@
+package crawler
+
+import (
+	"packages/src/linkgraph"
+	"sync"
+	"time"
+)
+
+const defaultweighing = time.Second
+
+// SetLinkgraph records the links of every page fetched in g and ranks the
+// entries of each host by the importance g estimates for them, on top of
+// their value under the budget. Every interval, a second by default, g is
+// swept once and the entries ranked are rated again. Without a budget, the
+// entries are ranked with no cap on the fetches. It must be called before
+// the crawl starts.
+func (c *Crawler) SetLinkgraph(g *linkgraph.Graph, every time.Duration) {
+	if every <= 0 {
+		every = defaultweighing
+	}
+	c.graph, c.graphEvery = g, every
+	c.frontier.SetPriority(g.Cash)
+	if !c.frontier.ranking() {
+		c.frontier.SetBudget(Budget{})
+	}
+}
+
+// weighing sweeps the link graph and reranks the frontier every interval
+// until the returned function is called
+func (c *Crawler) weighing() func() {
+	stop := make(chan struct{})
+	var wg sync.WaitGroup
+	wg.Add(1)
+	go func() {
+		defer wg.Done()
+		ticker := time.NewTicker(c.graphEvery)
+		defer ticker.Stop()
+		for {
+			select {
+			case <-ticker.C:
+				c.weigh()
+			case <-stop:
+				return
+			}
+		}
+	}()
+	return func() {
+		close(stop)
+		wg.Wait()
+	}
+}
+
+// weigh sweeps every page of the link graph once and rates the entries
+// ranked with the cash flowed to them
+func (c *Crawler) weigh() {
+	start := time.Now()
+	c.graph.Step(c.graph.Nodes())
+	c.frontier.Rerank()
+	c.metrics.graphSweep.ObserveDuration(time.Since(start))
+	c.metrics.graphNodes.Set(int64(c.graph.Nodes()))
+	c.metrics.graphBytes.Set(int64(c.graph.Bytes()))
+	c.metrics.graphEvicted.Set(int64(c.graph.Evicted()))
+}
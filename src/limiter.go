@@ -0,0 +1,209 @@
+package crawler
+
+import (
+	"context"
+	"math"
+	"net/netip"
+	"sync"
+	"time"
+)
+
+// Ratelimit caps the requests and the body bytes fetched from one key of a
+// level. Zero rates are unlimited.
+type Ratelimit struct {
+	Rate      float64 // requests per second
+	Burst     int     // requests sent at once after a quiet period, 50ms worth when zero
+	Bandwidth float64 // body bytes per second, zero for unlimited
+}
+
+// Ratelimits caps the fetches at each level of a hierarchy: the host, the
+// address it resolves to, the /24 (IPv6 /64) subnet of that address and the
+// whole crawler. They apply on top of the crawl delay of each host.
+type Ratelimits struct {
+	Host, IP, Subnet, Global Ratelimit
+}
+
+// Resolver maps host names to addresses, as net.Resolver does
+type Resolver interface {
+	LookupNetIP(ctx context.Context, network, host string) ([]netip.Addr, error)
+}
+
+// A ratelevel is what holds a fetch back: the crawl delay of its host or a
+// level of the rate limits
+type ratelevel int
+
+const (
+	delaylevel ratelevel = iota
+	hostlevel
+	iplevel
+	subnetlevel
+	globallevel
+	numRatelevels
+)
+
+var ratelevels = [numRatelevels]string{"delay", "host", "ip", "subnet", "global"}
+
+// SetRatelimits caps the fetch rate of the crawl at each level of limits.
+// A worker never waits on a limit: the entry it popped goes back to the
+// frontier, its host is parked until the limit allows a fetch and the
+// worker moves on to another host.
+func (c *Crawler) SetRatelimits(limits Ratelimits) {
+	c.limiter = newLimiter(limits)
+}
+
+// SetResolver replaces net.DefaultResolver for the address and subnet
+// levels of the rate limits
+func (c *Crawler) SetResolver(r Resolver) {
+	c.resolver = r
+}
+
+func (r Ratelimit) limited() bool {
+	return r.Rate > 0 || r.Bandwidth > 0
+}
+
+// burst is Burst, defaulting to 50ms worth of Rate, and at least 1
+func (r Ratelimit) burst() float64 {
+	if r.Burst > 0 {
+		return float64(r.Burst)
+	}
+	return max(math.Floor(r.Rate/20), 1)
+}
+
+// tokenbucket holds up to burst tokens, refilled at rate per second. A
+// bucket charged after the fact may go into debt.
+type tokenbucket struct {
+	rate, burst float64
+	tokens      float64
+	last        time.Time
+}
+
+func newTokenbucket(rate, burst float64) tokenbucket {
+	return tokenbucket{rate: rate, burst: burst, tokens: burst}
+}
+
+func (b *tokenbucket) refill(now time.Time) {
+	if !b.last.IsZero() {
+		b.tokens = min(b.tokens+now.Sub(b.last).Seconds()*b.rate, b.burst)
+	}
+	b.last = now
+}
+
+// wait returns how long until the bucket holds need tokens
+func (b *tokenbucket) wait(now time.Time, need float64) time.Duration {
+	if b.rate <= 0 {
+		return 0
+	}
+	b.refill(now)
+	if b.tokens >= need {
+		return 0
+	}
+	return time.Duration((need - b.tokens) / b.rate * float64(time.Second))
+}
+
+// ratebucket limits one key of a level
+type ratebucket struct {
+	requests tokenbucket
+	bytes    tokenbucket
+}
+
+// limiter holds the token buckets of every key of every level
+type limiter struct {
+	limits  [numRatelevels]Ratelimit
+	mutex   sync.Mutex
+	buckets [numRatelevels]map[string]*ratebucket
+}
+
+func newLimiter(limits Ratelimits) *limiter {
+	l := &limiter{}
+	l.limits[hostlevel], l.limits[iplevel] = limits.Host, limits.IP
+	l.limits[subnetlevel], l.limits[globallevel] = limits.Subnet, limits.Global
+	for level := range l.buckets {
+		l.buckets[level] = make(map[string]*ratebucket)
+	}
+	return l
+}
+
+// resolves reports whether the limits need the address of the hosts
+func (l *limiter) resolves() bool {
+	return l != nil && (l.limits[iplevel].limited() || l.limits[subnetlevel].limited())
+}
+
+// bucketsOf returns the buckets limiting host, resolved to addr when valid.
+// Unlimited levels get no bucket.
+func (l *limiter) bucketsOf(host string, addr netip.Addr) (buckets [numRatelevels]*ratebucket) {
+	if l == nil {
+		return
+	}
+	var keys [numRatelevels]string
+	keys[hostlevel], keys[globallevel] = host, "*"
+	if addr.IsValid() {
+		keys[iplevel], keys[subnetlevel] = addr.Unmap().String(), subnetOf(addr).String()
+	}
+
+	l.mutex.Lock()
+	defer l.mutex.Unlock()
+	for level, key := range keys {
+		limit := l.limits[level]
+		if key == "" || !limit.limited() {
+			continue
+		}
+		b, ok := l.buckets[level][key]
+		if !ok {
+			b = &ratebucket{
+				requests: newTokenbucket(limit.Rate, limit.burst()),
+				bytes:    newTokenbucket(limit.Bandwidth, limit.Bandwidth),
+			}
+			l.buckets[level][key] = b
+		}
+		buckets[level] = b
+	}
+	return
+}
+
+// reserve takes a request token from each of buckets if all of them allow
+// a fetch at now. Otherwise it takes nothing and returns how long until
+// they may, along with the level waited for the longest.
+func (l *limiter) reserve(now time.Time, buckets *[numRatelevels]*ratebucket) (time.Duration, ratelevel) {
+	if l == nil {
+		return 0, delaylevel
+	}
+	l.mutex.Lock()
+	defer l.mutex.Unlock()
+
+	var wait time.Duration
+	level := delaylevel
+	for i, b := range buckets {
+		if b == nil {
+			continue
+		}
+		// The bytes of the last fetches must be paid off first
+		if w := max(b.requests.wait(now, 1), b.bytes.wait(now, 0)); w > wait {
+			wait, level = w, ratelevel(i)
+		}
+	}
+	if wait > 0 {
+		return wait, level
+	}
+	for _, b := range buckets {
+		if b != nil {
+			b.requests.tokens--
+		}
+	}
+	return 0, delaylevel
+}
+
+// charge takes the bytes of a fetched body from the bandwidth of buckets
+func (l *limiter) charge(buckets *[numRatelevels]*ratebucket, bytes int) {
+	if l == nil {
+		return
+	}
+	l.mutex.Lock()
+	defer l.mutex.Unlock()
+	now := time.Now()
+	for _, b := range buckets {
+		if b != nil && b.bytes.rate > 0 {
+			b.bytes.refill(now)
+			b.bytes.tokens -= float64(bytes)
+		}
+	}
+}
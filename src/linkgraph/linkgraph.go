@@ -0,0 +1,301 @@
+// Package linkgraph keeps the link graph discovered by a crawl in a compact
+// adjacency store and estimates the importance of its pages online with
+// OPIC (Abiteboul, Preda and Cobena, Adaptive On-Line Page Importance
+// Computation). Every page starts with one unit of cash. Sweeping a fetched
+// page adds its cash to its history and splits it among its out-links, so
+// the pages not fetched yet gather the cash of the pages linking to them:
+// the more cash, the more important the page is likely to be.
+//
+// Pages are identified by the 64-bit FNV-1a hash of their URL and numbered
+// densely in order of discovery. The out-links of a page are stored once,
+// as the sorted numbers of their targets delta-encoded in uvarints, which
+// takes a couple of bytes per link as the links of a page tend to point to
+// pages discovered close together. Each page takes a fixed 32 bytes plus
+// its entry in the index, whatever its links.
+//
+// The graph holds a bounded number of pages, about four million by default.
+// When a page would not fit, the least valuable quarter of the pages are
+// evicted: those not fetched with the least cash first, then the fetched
+// ones with the least history and cash. The links to them are dropped and the rest
+// of the pages numbered again.
+package linkgraph
+
+import (
+	"cmp"
+	"encoding/binary"
+	"math"
+	"slices"
+	"sync"
+)
+
+const (
+	sweepslice   = 1024    // pages swept per lock
+	defaultlimit = 1 << 22 // pages held
+)
+
+// ID returns the node ID of url
+func ID(url string) uint64 {
+	const (
+		offset = 14695981039346656037
+		prime  = 1099511628211
+	)
+	h := uint64(offset)
+	for i := 0; i < len(url); i++ {
+		h ^= uint64(url[i])
+		h *= prime
+	}
+	return h
+}
+
+// node is a page of the graph
+type node struct {
+	id      uint64
+	cash    float32
+	history float32
+	offset  uint64 // of the out-links in edges
+	links   int32  // out-links, -1 until the page is added
+}
+
+// Graph is the link graph of a crawl. It is safe for concurrent use.
+type Graph struct {
+	mutex   sync.RWMutex
+	index   map[uint64]int32 // node number by ID
+	nodes   []node
+	edges   []byte
+	cursor  int     // next node swept
+	history float64 // sum of the histories
+	cash    float64 // sum of the cash
+	limit   int     // nodes held
+	evicted int     // nodes evicted so far
+
+	scratch []int32
+}
+
+// New returns an empty Graph
+func New() *Graph {
+	return &Graph{index: make(map[uint64]int32), limit: defaultlimit}
+}
+
+// SetLimit bounds the graph to n pages, at least 16 and at most
+// math.MaxInt32. It must be called before the graph is used.
+func (g *Graph) SetLimit(n int) {
+	g.mutex.Lock()
+	defer g.mutex.Unlock()
+	g.limit = min(max(n, 16), math.MaxInt32)
+}
+
+// node returns the number of the node of id, created with a unit of cash
+// when new. It is called with the mutex held.
+func (g *Graph) node(id uint64) int32 {
+	n, ok := g.index[id]
+	if !ok {
+		n = int32(len(g.nodes))
+		g.nodes = append(g.nodes, node{id: id, cash: 1, links: -1})
+		g.index[id] = n
+		g.cash++
+	}
+	return n
+}
+
+// Add records the out-links of the page at from, which must be given once.
+// Later calls for the same page are ignored, as are links to itself. Pages
+// are evicted first when the page and its links might not fit, and the
+// links beyond a quarter of the limit are dropped.
+func (g *Graph) Add(from string, to []string) {
+	source := ID(from)
+	g.mutex.Lock()
+	defer g.mutex.Unlock()
+
+	to = to[:min(len(to), g.limit/4)]
+	if len(g.nodes)+len(to)+1 > g.limit {
+		g.evict(g.limit - g.limit/4 - len(to) - 1)
+	}
+	n := g.node(source)
+	if g.nodes[n].links >= 0 {
+		return
+	}
+	targets := g.scratch[:0]
+	for _, link := range to {
+		if t := g.node(ID(link)); t != n {
+			targets = append(targets, t)
+		}
+	}
+	slices.Sort(targets)
+	targets = slices.Compact(targets)
+
+	offset := len(g.edges)
+	prev := int32(0)
+	for _, t := range targets {
+		g.edges = binary.AppendUvarint(g.edges, uint64(t-prev))
+		prev = t
+	}
+	g.nodes[n].offset, g.nodes[n].links = uint64(offset), int32(len(targets))
+	g.scratch = targets
+}
+
+// evict drops all but keep nodes, the unfetched with the least cash first,
+// then the fetched with the least history and cash, and numbers the rest again in
+// order. It is called with the mutex held.
+func (g *Graph) evict(keep int) {
+	order := make([]int32, len(g.nodes))
+	for i := range order {
+		order[i] = int32(i)
+	}
+	slices.SortFunc(order, func(a, b int32) int {
+		u, v := &g.nodes[a], &g.nodes[b]
+		if fu, fv := u.links >= 0, v.links >= 0; fu != fv {
+			if fu {
+				return 1
+			}
+			return -1
+		}
+		return cmp.Compare(u.history+u.cash, v.history+v.cash)
+	})
+	number := make([]int32, len(g.nodes)) // new number by old, -1 if evicted
+	for _, i := range order[:len(order)-keep] {
+		v := &g.nodes[i]
+		number[i] = -1
+		g.history -= float64(v.history)
+		g.cash -= float64(v.cash)
+		delete(g.index, v.id)
+	}
+	g.evicted += len(order) - keep
+	kept, cursor := int32(0), 0
+	for i := range number {
+		if number[i] < 0 {
+			continue
+		}
+		if i < g.cursor {
+			cursor++
+		}
+		number[i] = kept
+		g.index[g.nodes[i].id] = kept
+		kept++
+	}
+
+	nodes := make([]node, 0, len(g.nodes))
+	edges := make([]byte, 0, len(g.edges))
+	for i, v := range g.nodes {
+		if number[i] < 0 {
+			continue
+		}
+		if v.links > 0 {
+			data := g.edges[v.offset:]
+			t, prev, links := uint64(0), int32(0), int32(0)
+			v.offset = uint64(len(edges))
+			for k := int32(0); k < v.links; k++ {
+				delta, size := binary.Uvarint(data)
+				data = data[size:]
+				t += delta
+				if n := number[t]; n >= 0 {
+					edges = binary.AppendUvarint(edges, uint64(n-prev))
+					prev = n
+					links++
+				}
+			}
+			v.links = links
+		}
+		nodes = append(nodes, v)
+	}
+	g.nodes, g.edges, g.cursor = nodes, edges, cursor
+}
+
+// Step sweeps up to n of the pages added, round-robin, and returns the
+// number swept. The lock is released every few pages so that Add and the
+// lookups are not held back by long sweeps.
+func (g *Graph) Step(n int) int {
+	swept := 0
+	for swept < n {
+		g.mutex.Lock()
+		total := len(g.nodes)
+		slice := min(sweepslice, n-swept, total)
+		for i := 0; i < slice; i++ {
+			if g.cursor >= len(g.nodes) {
+				g.cursor = 0
+			}
+			g.sweep(g.cursor)
+			g.cursor++
+		}
+		g.mutex.Unlock()
+		swept += slice
+		if slice == 0 || swept >= total {
+			break
+		}
+	}
+	return swept
+}
+
+// sweep moves the cash of a page added to its history and its out-links.
+// A page without out-links keeps nothing but its history.
+func (g *Graph) sweep(i int) {
+	v := &g.nodes[i]
+	if v.links < 0 || v.cash == 0 {
+		return
+	}
+	cash := v.cash
+	v.history += cash
+	v.cash = 0
+	g.history += float64(cash)
+	g.cash -= float64(cash)
+	if v.links == 0 {
+		return
+	}
+	share := cash / float32(v.links)
+	edges := g.edges[v.offset:]
+	t := uint64(0)
+	for k := int32(0); k < v.links; k++ {
+		delta, size := binary.Uvarint(edges)
+		edges = edges[size:]
+		t += delta
+		g.nodes[t].cash += share
+	}
+	g.cash += float64(cash)
+}
+
+// Cash returns the cash held by the page at url, zero when unknown. For a
+// page not fetched yet, it is the share of importance flowed to it so far.
+func (g *Graph) Cash(url string) float64 {
+	id := ID(url)
+	g.mutex.RLock()
+	defer g.mutex.RUnlock()
+	if n, ok := g.index[id]; ok {
+		return float64(g.nodes[n].cash)
+	}
+	return 0
+}
+
+// Importance returns the estimated importance of the page at url, the
+// fraction of the history and cash of the graph it holds
+func (g *Graph) Importance(url string) float64 {
+	id := ID(url)
+	g.mutex.RLock()
+	defer g.mutex.RUnlock()
+	n, ok := g.index[id]
+	if !ok || g.history+g.cash == 0 {
+		return 0
+	}
+	return float64(g.nodes[n].history+g.nodes[n].cash) / (g.history + g.cash)
+}
+
+// Evicted returns the number of pages evicted from the graph so far
+func (g *Graph) Evicted() int {
+	g.mutex.RLock()
+	defer g.mutex.RUnlock()
+	return g.evicted
+}
+
+// Nodes returns the number of pages in the graph
+func (g *Graph) Nodes() int {
+	g.mutex.RLock()
+	defer g.mutex.RUnlock()
+	return len(g.nodes)
+}
+
+// Bytes estimates the memory held by the graph: the nodes, their index
+// and the out-links
+func (g *Graph) Bytes() int {
+	g.mutex.RLock()
+	defer g.mutex.RUnlock()
+	const indexentry = 24 // ID and number, with the overhead of the map
+	return cap(g.nodes)*32 + len(g.index)*indexentry + cap(g.edges)
+}
@@ -0,0 +1,143 @@
+package crawler
+
+import (
+	"packages/src/fetcher"
+	"packages/src/metrics"
+)
+
+const hostseries = 1024 // hosts with a series of their own, the others sharing "other"
+
+// Crawlermetrics instruments the crawl loop. The zero value records nothing.
+type Crawlermetrics struct {
+	fetchLatency   *metrics.Histogram
+	fetchErrors    *metrics.Counter
+	retries        *metrics.Counter
+	cancelled      *metrics.Counter
+	parked         *metrics.Counter
+	abandoned      *metrics.Counter
+	sitemaps       *metrics.Counter
+	sitemapURLs    [numSitemapOutcomes]*metrics.Counter
+	pages          *metrics.Counter
+	verdicts       [numVerdicts]*metrics.Counter
+	discarded      [fetcher.NumDiscards]*metrics.Counter
+	decisions      [numDecisionOutcomes]*metrics.Counter
+	frontierDepth  *metrics.Gaugevec
+	pruned         *metrics.Counter
+	overbudget     *metrics.Counter
+	routed         *metrics.Counter
+	nearDuplicates *metrics.Counter
+	delayWait      *metrics.Histogram
+	deferred       [numRatelevels]*metrics.Counter
+	stageWorkers   *metrics.Gaugevec
+	stageBusy      *metrics.Countervec
+	stageBlocked   *metrics.Countervec
+	stageQueued    *metrics.Gaugevec
+	checkpoints    [numCheckpointOutcomes]*metrics.Counter
+	walCommits     [numWalOutcomes]*metrics.Counter
+	walSync        *metrics.Histogram
+	graphNodes     *metrics.Gauge
+	graphBytes     *metrics.Gauge
+	graphEvicted   *metrics.Gauge
+	graphSweep     *metrics.Histogram
+}
+
+// NewCrawlermetrics registers the crawler metrics in registry
+func NewCrawlermetrics(registry *metrics.Registry) *Crawlermetrics {
+	m := &Crawlermetrics{
+		fetchLatency: registry.Histogram("crawler_fetch_duration_seconds",
+			"Duration of page fetches as returned by the fetcher.", metrics.DefaultBuckets),
+		fetchErrors: registry.Counter("crawler_fetch_errors_total",
+			"Page fetches that failed."),
+		retries: registry.Counter("crawler_retries_total",
+			"Page fetches sent back to the frontier to be tried again after a transient failure."),
+		cancelled: registry.Counter("crawler_pages_cancelled_total",
+			"Pages abandoned mid-fetch or mid-parse as the crawl was stopped."),
+		parked: registry.Counter("crawler_hosts_parked_total",
+			"Times a host was parked in the frontier as its circuit breaker opened."),
+		abandoned: registry.Counter("crawler_links_abandoned_total",
+			"Queued links dropped as their host kept failing."),
+		sitemaps: registry.Counter("crawler_sitemaps_total",
+			"Sitemap and sitemap index files read."),
+		pages: registry.Counter("crawler_pages_total",
+			"Pages fetched and parsed."),
+		frontierDepth: registry.Gaugevec("crawler_frontier_depth",
+			"Links queued per host, the hosts beyond the first 1024 summed under other.", "host"),
+		pruned: registry.Counter("crawler_frontier_pruned_total",
+			"Links dropped for exceeding the crawl depth."),
+		overbudget: registry.Counter("crawler_frontier_overbudget_total",
+			"Links dropped as their host had spent its fetch budget."),
+		routed: registry.Counter("crawler_links_routed_total",
+			"Links handed to the cluster node owning their host."),
+		nearDuplicates: registry.Counter("crawler_near_duplicates_total",
+			"Pages whose links were not expanded as their text nearly duplicates another page."),
+		delayWait: registry.Histogram("crawler_delay_wait_seconds",
+			"Time hosts were parked for their crawl delay or the rate limits.", metrics.DefaultBuckets),
+		stageWorkers: registry.Gaugevec("crawler_stage_workers",
+			"Workers of each pipeline stage.", "stage"),
+		stageBusy: registry.Countervec("crawler_stage_busy_microseconds_total",
+			"Time pipeline workers spent working, by stage.", "stage"),
+		stageBlocked: registry.Countervec("crawler_stage_blocked_microseconds_total",
+			"Time pipeline workers spent blocked on the queue of the next stage, by stage.", "stage"),
+		stageQueued: registry.Gaugevec("crawler_stage_queue_length",
+			"Pages queued for each pipeline stage when last fed.", "stage"),
+	}
+	m.frontierDepth.SetLimit(hostseries, "other")
+	links := registry.Countervec("crawler_links_total",
+		"Links tested against the crawling rules by verdict.", "verdict")
+	for v := Verdict(0); v < numVerdicts; v++ {
+		m.verdicts[v] = links.With(v.String())
+	}
+	discarded := registry.Countervec("crawler_links_discarded_total",
+		"Links dropped by the parser before resolution by reason.", "reason")
+	for d := fetcher.Discard(0); d < fetcher.NumDiscards; d++ {
+		m.discarded[d] = discarded.With(d.String())
+	}
+	decisions := registry.Countervec("crawler_robots_decisions_total",
+		"Robots.txt tests by outcome of the per-host directory cache: hit, miss, "+
+			"or mixed for directories whose paths are matched one by one.", "outcome")
+	for o, name := range decisionOutcomes {
+		m.decisions[o] = decisions.With(name)
+	}
+	deferred := registry.Countervec("crawler_fetches_deferred_total",
+		"Entries handed back to the frontier by the limit holding their fetch back.", "limit")
+	for level, name := range ratelevels {
+		m.deferred[level] = deferred.With(name)
+	}
+	checkpoints := registry.Countervec("crawler_checkpoints_total",
+		"Checkpoints of the crawl state by outcome: saved, failed, or compacted "+
+			"when the deltas were merged into a new base.", "outcome")
+	for o, name := range checkpointOutcomes {
+		m.checkpoints[o] = checkpoints.With(name)
+	}
+	walCommits := registry.Countervec("crawler_wal_commits_total",
+		"Group commits of the write-ahead log by outcome.", "outcome")
+	for o, name := range walOutcomes {
+		m.walCommits[o] = walCommits.With(name)
+	}
+	m.walSync = registry.Histogram("crawler_wal_commit_seconds",
+		"Time to write and fsync each group commit of the write-ahead log.", metrics.DefaultBuckets)
+	m.graphNodes = registry.Gauge("crawler_linkgraph_nodes",
+		"Pages in the link graph, fetched or linked to.")
+	m.graphBytes = registry.Gauge("crawler_linkgraph_bytes",
+		"Estimated memory held by the link graph.")
+	m.graphEvicted = registry.Gauge("crawler_linkgraph_evicted",
+		"Pages evicted from the link graph to keep it within its limit.")
+	m.graphSweep = registry.Histogram("crawler_linkgraph_sweep_seconds",
+		"Time to sweep the link graph and rerank the frontier.", metrics.DefaultBuckets)
+	sitemapURLs := registry.Countervec("crawler_sitemap_urls_total",
+		"URLs listed by sitemaps by outcome.", "outcome")
+	for o, name := range sitemapOutcomes {
+		m.sitemapURLs[o] = sitemapURLs.With(name)
+	}
+	return m
+}
+
+// Outcomes of the URLs listed by sitemaps
+const (
+	sitemapQueued = iota
+	sitemapUnchanged
+	sitemapRejected
+	numSitemapOutcomes
+)
+
+var sitemapOutcomes = [numSitemapOutcomes]string{"queued", "unchanged", "rejected"}
@@ -0,0 +1,167 @@
+// Package metrics implements counters, gauges and histograms updated with
+// atomics only, exposed in the Prometheus text format.
+//
+// Every method accepts a nil receiver, so instrumented code does not need
+// to check whether metrics were configured.
+package metrics
+
+import (
+	"math"
+	"sort"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// Counter is a monotonically increasing value
+type Counter struct {
+	value atomic.Uint64
+}
+
+func (c *Counter) Inc() {
+	c.Add(1)
+}
+
+func (c *Counter) Add(n uint64) {
+	if c != nil {
+		c.value.Add(n)
+	}
+}
+
+func (c *Counter) Value() uint64 {
+	if c == nil {
+		return 0
+	}
+	return c.value.Load()
+}
+
+// Gauge is a value that can go up and down
+type Gauge struct {
+	value atomic.Int64
+}
+
+func (g *Gauge) Set(v int64) {
+	if g != nil {
+		g.value.Store(v)
+	}
+}
+
+func (g *Gauge) Add(n int64) {
+	if g != nil {
+		g.value.Add(n)
+	}
+}
+
+func (g *Gauge) Value() int64 {
+	if g == nil {
+		return 0
+	}
+	return g.value.Load()
+}
+
+// DefaultBuckets are latency bounds in seconds, from 1ms to 30s
+var DefaultBuckets = []float64{.001, .0025, .005, .01, .025, .05, .1, .25, .5, 1, 2.5, 5, 10, 30}
+
+// Histogram counts observations into fixed buckets
+type Histogram struct {
+	bounds []float64
+	counts []atomic.Uint64 // per bucket, the last one is +Inf
+	count  atomic.Uint64
+	sum    atomic.Uint64 // float64 bits
+}
+
+func newHistogram(bounds []float64) *Histogram {
+	return &Histogram{
+		bounds: bounds,
+		counts: make([]atomic.Uint64, len(bounds)+1),
+	}
+}
+
+func (h *Histogram) Observe(v float64) {
+	if h == nil {
+		return
+	}
+	h.counts[sort.SearchFloat64s(h.bounds, v)].Add(1)
+	h.count.Add(1)
+	for {
+		old := h.sum.Load()
+		sum := math.Float64bits(math.Float64frombits(old) + v)
+		if h.sum.CompareAndSwap(old, sum) {
+			return
+		}
+	}
+}
+
+// ObserveDuration records d in seconds
+func (h *Histogram) ObserveDuration(d time.Duration) {
+	h.Observe(d.Seconds())
+}
+
+// Sum returns the total of all observations
+func (h *Histogram) Sum() float64 {
+	if h == nil {
+		return 0
+	}
+	return math.Float64frombits(h.sum.Load())
+}
+
+func (h *Histogram) Count() uint64 {
+	if h == nil {
+		return 0
+	}
+	return h.count.Load()
+}
+
+// Countervec is a family of counters partitioned by one label
+type Countervec struct {
+	children sync.Map // string -> *Counter
+}
+
+// With returns the counter for the label value, creating it on first use
+func (v *Countervec) With(value string) *Counter {
+	if v == nil {
+		return nil
+	}
+	if c, ok := v.children.Load(value); ok {
+		return c.(*Counter)
+	}
+	c, _ := v.children.LoadOrStore(value, &Counter{})
+	return c.(*Counter)
+}
+
+// Gaugevec is a family of gauges partitioned by one label
+type Gaugevec struct {
+	children sync.Map // string -> *Gauge
+	limit    int
+	overflow string
+	size     atomic.Int64
+}
+
+// With returns the gauge for the label value, creating it on first use.
+// Creating a gauge takes a lock, so callers updating one often resolve it
+// once and keep it.
+func (v *Gaugevec) With(value string) *Gauge {
+	if v == nil {
+		return nil
+	}
+	if g, ok := v.children.Load(value); ok {
+		return g.(*Gauge)
+	}
+	if v.limit > 0 && v.size.Load() >= int64(v.limit) && value != v.overflow {
+		return v.With(v.overflow)
+	}
+	g, loaded := v.children.LoadOrStore(value, &Gauge{})
+	if !loaded {
+		v.size.Add(1)
+	}
+	return g.(*Gauge)
+}
+
+// SetLimit bounds the family to about n label values, the gauges of the
+// values beyond sharing the overflow value. It must be called before the
+// first With.
+func (v *Gaugevec) SetLimit(n int, overflow string) {
+	if v != nil {
+		v.limit, v.overflow = n, overflow
+	}
+}
@@ -0,0 +1,144 @@
+package metrics
+
+import (
+	"bufio"
+	"fmt"
+	"io"
+	"net/http"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+)
+
+type family struct {
+	name  string
+	help  string
+	kind  string
+	label string
+	write func(w io.Writer, f *family)
+}
+
+// Registry holds the metric families exposed on an HTTP endpoint
+type Registry struct {
+	mutex    sync.Mutex
+	families []*family
+}
+
+// NewRegistry creates a new Registry struct
+func NewRegistry() *Registry {
+	return &Registry{}
+}
+
+func (r *Registry) register(f *family) {
+	r.mutex.Lock()
+	defer r.mutex.Unlock()
+	r.families = append(r.families, f)
+}
+
+// Counter registers a new counter
+func (r *Registry) Counter(name, help string) *Counter {
+	c := &Counter{}
+	r.register(&family{name: name, help: help, kind: "counter",
+		write: func(w io.Writer, f *family) {
+			fmt.Fprintf(w, "%s %d\n", f.name, c.Value())
+		}})
+	return c
+}
+
+// Gauge registers a new gauge
+func (r *Registry) Gauge(name, help string) *Gauge {
+	g := &Gauge{}
+	r.register(&family{name: name, help: help, kind: "gauge",
+		write: func(w io.Writer, f *family) {
+			fmt.Fprintf(w, "%s %d\n", f.name, g.Value())
+		}})
+	return g
+}
+
+// Countervec registers a new counter family partitioned by label
+func (r *Registry) Countervec(name, help, label string) *Countervec {
+	v := &Countervec{}
+	r.register(&family{name: name, help: help, kind: "counter", label: label,
+		write: func(w io.Writer, f *family) {
+			for _, value := range sortedKeys(&v.children) {
+				fmt.Fprintf(w, "%s{%s=\"%s\"} %d\n", f.name, f.label, labelEscaper.Replace(value), v.With(value).Value())
+			}
+		}})
+	return v
+}
+
+// Gaugevec registers a new gauge family partitioned by label
+func (r *Registry) Gaugevec(name, help, label string) *Gaugevec {
+	v := &Gaugevec{}
+	r.register(&family{name: name, help: help, kind: "gauge", label: label,
+		write: func(w io.Writer, f *family) {
+			for _, value := range sortedKeys(&v.children) {
+				fmt.Fprintf(w, "%s{%s=\"%s\"} %d\n", f.name, f.label, labelEscaper.Replace(value), v.With(value).Value())
+			}
+		}})
+	return v
+}
+
+// Histogram registers a new histogram with the given upper bounds
+func (r *Registry) Histogram(name, help string, bounds []float64) *Histogram {
+	h := newHistogram(bounds)
+	r.register(&family{name: name, help: help, kind: "histogram",
+		write: func(w io.Writer, f *family) {
+			var cumulative uint64
+			for i, bound := range h.bounds {
+				cumulative += h.counts[i].Load()
+				fmt.Fprintf(w, "%s_bucket{le=\"%s\"} %d\n", f.name,
+					strconv.FormatFloat(bound, 'g', -1, 64), cumulative)
+			}
+			cumulative += h.counts[len(h.bounds)].Load()
+			fmt.Fprintf(w, "%s_bucket{le=\"+Inf\"} %d\n", f.name, cumulative)
+			fmt.Fprintf(w, "%s_sum %g\n", f.name, h.Sum())
+			fmt.Fprintf(w, "%s_count %d\n", f.name, h.count.Load())
+		}})
+	return h
+}
+
+// WriteTo writes every family in the Prometheus text exposition format
+func (r *Registry) WriteTo(out io.Writer) (int64, error) {
+	r.mutex.Lock()
+	families := append([]*family(nil), r.families...)
+	r.mutex.Unlock()
+
+	cw := &countingWriter{w: out}
+	w := bufio.NewWriter(cw)
+	for _, f := range families {
+		fmt.Fprintf(w, "# HELP %s %s\n# TYPE %s %s\n", f.name, f.help, f.name, f.kind)
+		f.write(w, f)
+	}
+	err := w.Flush()
+	return cw.n, err
+}
+
+func (r *Registry) ServeHTTP(w http.ResponseWriter, _ *http.Request) {
+	w.Header().Set("Content-Type", "text/plain; version=0.0.4")
+	r.WriteTo(w)
+}
+
+type countingWriter struct {
+	w io.Writer
+	n int64
+}
+
+func (c *countingWriter) Write(p []byte) (int, error) {
+	n, err := c.w.Write(p)
+	c.n += int64(n)
+	return n, err
+}
+
+func sortedKeys(m *sync.Map) []string {
+	var keys []string
+	m.Range(func(k, _ any) bool {
+		keys = append(keys, k.(string))
+		return true
+	})
+	sort.Strings(keys)
+	return keys
+}
+
+var labelEscaper = strings.NewReplacer(`\`, `\\`, `"`, `\"`, "\n", `\n`)
@@ -0,0 +1,393 @@
+package crawler
+
+import (
+	"context"
+	"packages/src/fetcher"
+	"packages/src/metrics"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// Pages flow through three stages, each with its own pool of workers:
+// fetch (I/O bound, Crawlersettings concurrency), parse (CPU bound) and
+// filter, sharded by host so the rules of a host are checked by a single
+// worker. The queues between stages are bounded, so a slow stage holds
+// back the ones feeding it.
+
+const stagequeue = 4 // queued pages per worker of the receiving stage
+
+// A stage is a pool of pipeline workers. It accumulates the time workers
+// spend working and blocked on the queue of the next stage.
+type stage struct {
+	name    string
+	workers int
+	busy    atomic.Int64
+	blocked atomic.Int64
+
+	busyTotal    *metrics.Counter
+	blockedTotal *metrics.Counter
+	queued       *metrics.Gauge
+}
+
+func newStage(name string, workers int, m *Crawlermetrics) *stage {
+	m.stageWorkers.With(name).Set(int64(workers))
+	return &stage{
+		name:         name,
+		workers:      workers,
+		busyTotal:    m.stageBusy.With(name),
+		blockedTotal: m.stageBlocked.With(name),
+		queued:       m.stageQueued.With(name),
+	}
+}
+
+// work runs f, accounting it as busy time
+func (s *stage) work(f func()) {
+	start := time.Now()
+	f()
+	d := time.Since(start)
+	s.busy.Add(int64(d))
+	s.busyTotal.Add(uint64(d.Microseconds()))
+}
+
+// send queues v for the stage reading queue, accounting the time s spends
+// waiting for room as blocked
+func send[T any](s *stage, queue chan<- T, v T) {
+	select {
+	case queue <- v:
+	default:
+		start := time.Now()
+		queue <- v
+		d := time.Since(start)
+		s.blocked.Add(int64(d))
+		s.blockedTotal.Add(uint64(d.Microseconds()))
+	}
+}
+
+// Stagestats reports the activity of a pipeline stage over the crawl
+type Stagestats struct {
+	Name        string
+	Workers     int
+	Utilization float64 // fraction of worker time spent working
+	Blocked     float64 // fraction of worker time blocked on the next stage
+}
+
+// SetStages sizes the parse and filter stages of the pipeline. They default
+// to GOMAXPROCS workers each.
+func (c *Crawler) SetStages(parsers, filters int) {
+	c.parsers, c.filters = max(parsers, 1), max(filters, 1)
+}
+
+// Stages reports the activity of the pipeline stages of the running or
+// last crawl
+func (c *Crawler) Stages() []Stagestats {
+	start, end := c.started.Load(), c.ended.Load()
+	if start == 0 {
+		return nil
+	}
+	if end == 0 {
+		end = time.Now().UnixNano()
+	}
+	elapsed := float64(end - start)
+
+	stats := make([]Stagestats, 0, len(c.stages))
+	for _, s := range c.stages {
+		capacity := elapsed * float64(s.workers)
+		stats = append(stats, Stagestats{
+			Name:        s.name,
+			Workers:     s.workers,
+			Utilization: float64(s.busy.Load()) / capacity,
+			Blocked:     float64(s.blocked.Load()) / capacity,
+		})
+	}
+	return stats
+}
+
+// pagejob is a frontier entry travelling through the pipeline
+type pagejob struct {
+	entry  Entry
+	host   *hoststate
+	page   *fetcher.Page
+	parsed bool // the fetcher parsed the page along with the download
+}
+
+// pipeline runs the stages until the frontier stops handing out entries and
+// the pages in flight have been filtered. Once ctx is done, fetches and
+// parses in flight are abandoned.
+func (c *Crawler) pipeline(ctx context.Context, results chan<- *Parsedresults) (unsent []*Parsedresults) {
+	fetch := newStage("fetch", c.settings.concurrency, c.metrics)
+	parse := newStage("parse", c.parsers, c.metrics)
+	filter := newStage("filter", c.filters, c.metrics)
+	c.stages = []*stage{fetch, parse, filter}
+
+	parseq := make(chan *pagejob, stagequeue*parse.workers)
+	filterqs := make([]chan *pagejob, filter.workers)
+	for i := range filterqs {
+		filterqs[i] = make(chan *pagejob, stagequeue)
+	}
+
+	// With a write-ahead log, results wait for the commit holding their page
+	// as done before they are sent. Once the log is broken the crawl stops,
+	// and the results left are returned to wait for the last checkpoint.
+	var committed chan<- walresult
+	var forwarder sync.WaitGroup
+	if c.checkpoints.logging() {
+		held := make(chan walresult, walheld)
+		committed = held
+		forwarder.Add(1)
+		go func() {
+			defer forwarder.Done()
+			for r := range held {
+				if !c.checkpoints.wal.await(r.lsn) {
+					c.Stop()
+					unsent = append(unsent, r.res)
+					continue
+				}
+				results <- r.res
+			}
+		}()
+	}
+
+	var fetchers, parsers, filters sync.WaitGroup
+	for i := 0; i < fetch.workers; i++ {
+		fetchers.Add(1)
+		go func() {
+			defer fetchers.Done()
+			for {
+				entry, ok := c.frontier.Pop()
+				if !ok {
+					return
+				}
+				if job := c.fetchpage(ctx, fetch, entry); job != nil {
+					send(fetch, parseq, job)
+					parse.queued.Set(int64(len(parseq)))
+				}
+			}
+		}()
+	}
+	for i := 0; i < parse.workers; i++ {
+		parsers.Add(1)
+		go func() {
+			defer parsers.Done()
+			for job := range parseq {
+				if c.parsepage(ctx, parse, job) {
+					queue := filterqs[shard(job.entry.URL.Host, len(filterqs))]
+					send(parse, queue, job)
+					filter.queued.Set(int64(len(queue)))
+				}
+			}
+		}()
+	}
+	for _, queue := range filterqs {
+		filters.Add(1)
+		go func(queue chan *pagejob) {
+			defer filters.Done()
+			for job := range queue {
+				var res *Parsedresults
+				filter.work(func() { res = c.filterpage(job) })
+				if committed != nil {
+					send(filter, committed, walresult{res, c.checkpoints.position()})
+				} else {
+					send(filter, results, res)
+				}
+			}
+		}(queue)
+	}
+
+	fetchers.Wait()
+	close(parseq)
+	parsers.Wait()
+	for _, queue := range filterqs {
+		close(queue)
+	}
+	filters.Wait()
+	if committed != nil {
+		close(committed)
+		forwarder.Wait()
+	}
+	return unsent
+}
+
+// fetchpage downloads the page of entry if its host allows a fetch now, and
+// otherwise defers the entry until it does. It returns nil when there is
+// nothing left to do with the entry.
+func (c *Crawler) fetchpage(ctx context.Context, s *stage, entry Entry) *pagejob {
+	link := entry.URL
+	if c.frontier.Overbudget(entry) {
+		c.metrics.overbudget.Inc()
+		c.checkpoints.complete(link)
+		c.frontier.Done(entry)
+		return nil
+	}
+	var host *hoststate
+	s.work(func() { host = c.host(ctx, link) })
+	if !host.rules.Permits(link) {
+		c.metrics.verdicts[Robots].Inc()
+		c.checkpoints.complete(link)
+		c.frontier.Done(entry)
+		return nil
+	}
+	if ctx.Err() != nil {
+		c.frontier.Done(entry)
+		return nil
+	}
+	if wait, level := host.admit(c.limiter); wait > 0 {
+		c.metrics.delayWait.ObserveDuration(wait)
+		c.metrics.deferred[level].Inc()
+		switch level {
+		case globallevel:
+			// No other host may be fetched either
+			c.frontier.Pause(wait)
+			wait = 0
+		case delaylevel, iplevel, subnetlevel:
+			// Nor may the hosts sharing its schedule
+			c.frontier.Parkgroup(link.Host, wait)
+			wait = 0
+		}
+		c.frontier.Defer(entry, wait)
+		return nil
+	}
+
+	job := &pagejob{entry: entry, host: host, page: fetcher.NewPage()}
+	job.page.Simhash = c.nearDups != nil
+	job.page.Filter = host.filter
+	var (
+		d   time.Duration
+		err error
+	)
+	paced := fetcher.Paced(ctx, c.hedge(host))
+	s.work(func() {
+		c.phase(link.Host, "fetch", func() {
+			d, job.parsed, err = c.fetch(paced, link.String(), job.page)
+		})
+	})
+	if ctx.Err() != nil {
+		c.metrics.cancelled.Inc()
+		c.finish(job)
+		return nil
+	}
+	dropped := c.guard(host, link.Host, err)
+	c.fetched.Add(1)
+	c.metrics.fetchLatency.ObserveDuration(d)
+	if err != nil {
+		if !dropped && c.retry(job, err) {
+			return nil
+		}
+		c.metrics.fetchErrors.Inc()
+		c.checkpoints.complete(link)
+		c.finish(job)
+		return nil
+	}
+	c.limiter.charge(&host.buckets, len(job.page.Body()))
+	return job
+}
+
+// fetch downloads link into page within the fetch timeout. Fetchers that
+// are not Pagefetchers parse the page along with the download, which fetch
+// reports.
+func (c *Crawler) fetch(ctx context.Context, link string, page *fetcher.Page) (time.Duration, bool, error) {
+	ctx, cancel := context.WithTimeout(ctx, c.settings.fetchtimeout)
+	defer cancel()
+	if pagefetcher, ok := c.fetcher.(Pagefetcher); ok {
+		d, err := pagefetcher.Fetchbody(ctx, link, page)
+		return d, false, err
+	}
+	d, links, err := c.fetcher.Fetchlinks(ctx, link)
+	page.Links = append(page.Links, links...)
+	fetcher.Releaselinks(links)
+	return d, true, err
+}
+
+// parsepage extracts the links of a downloaded page. It reports whether the
+// page goes on to the filter stage.
+func (c *Crawler) parsepage(ctx context.Context, s *stage, job *pagejob) bool {
+	if ctx.Err() != nil {
+		c.metrics.cancelled.Inc()
+		c.finish(job)
+		return false
+	}
+	if !job.parsed {
+		var err error
+		s.work(func() {
+			err = c.fetcher.(Pagefetcher).Parsepage(ctx, job.entry.URL.String(), job.page)
+		})
+		if ctx.Err() != nil {
+			c.metrics.cancelled.Inc()
+			c.finish(job)
+			return false
+		}
+		if err != nil {
+			c.metrics.fetchErrors.Inc()
+			c.checkpoints.complete(job.entry.URL)
+			c.finish(job)
+			return false
+		}
+	}
+	c.metrics.pages.Inc()
+	return true
+}
+
+// filterpage tests the links of a parsed page against the crawling rules of
+// its host, queues the accepted ones and returns the page result. The links
+// queued and the page being done land in the same checkpoint.
+func (c *Crawler) filterpage(job *pagejob) *Parsedresults {
+	defer c.finish(job)
+	link, page := job.entry.URL, job.page
+	c.checkpoints.begin()
+	defer c.checkpoints.end()
+	defer c.checkpoints.complete(link)
+
+	for reason, n := range page.Discarded {
+		c.metrics.discarded[reason].Add(uint64(n))
+	}
+	res := newParsedresults(link.String())
+	if c.duplicate(page) {
+		c.metrics.nearDuplicates.Inc()
+		return res
+	}
+	c.phase(link.Host, "dedup", func() {
+		var buf [64]Verdict
+		verdicts := job.host.rules.CheckBatch(page.Links, &page.Arena, buf[:0])
+		for i, l := range page.Links {
+			verdict := verdicts[i]
+			c.metrics.verdicts[verdict].Inc()
+			switch {
+			case verdict == Accepted:
+				l = fetcher.CloneURL(l)
+				res.Links = append(res.Links, l.String())
+				c.enqueue(l, job.entry.Depth+1)
+			case verdict == Offdomain && c.router != nil:
+				l = fetcher.CloneURL(l)
+				res.Links = append(res.Links, l.String())
+				c.follow(l, job.entry.Depth+1)
+			}
+		}
+		if c.frontier.ranking() {
+			var buf [64]string
+			keys := buf[:0]
+			for _, l := range page.Links {
+				keys = append(keys, cachekey(l, &page.Arena))
+			}
+			c.frontier.Cite(link.Host, page.Links, keys)
+			if c.graph != nil {
+				c.graph.Add(cachekey(link, &page.Arena), keys)
+			}
+		}
+	})
+	return res
+}
+
+// finish releases the page of job and hands its entry back to the frontier
+func (c *Crawler) finish(job *pagejob) {
+	job.page.Release()
+	c.frontier.Done(job.entry)
+}
+
+// shard maps host to one of n filter workers
+func shard(host string, n int) int {
+	h := uint32(2166136261)
+	for i := 0; i < len(host); i++ {
+		h = (h ^ uint32(host[i])) * 16777619
+	}
+	return int(h % uint32(n))
+}
@@ -0,0 +1,66 @@
+package crawler
+
+import (
+	"net/netip"
+	"sync"
+	"time"
+)
+
+// Politeness selects what the crawl delay spaces fetches of: each host, or
+// all the hosts sharing an address or a subnet, such as the thousands of
+// names of a shared hosting server.
+type Politeness int
+
+const (
+	Perhost    Politeness = iota
+	Peraddress            // hosts resolving to the same address
+	Persubnet             // hosts resolving to the same /24 (IPv6 /64)
+)
+
+// SetPoliteness keys the crawl delay schedule by p. With Peraddress or
+// Persubnet the hosts are resolved once, and the frontier merges the queues
+// of the hosts sharing a key: they are fetched one at a time, the hosts
+// taking turns, each fetch holding the next one back by the crawl delay of
+// the host it fetched. Hosts that do not resolve keep a schedule of their
+// own.
+func (c *Crawler) SetPoliteness(p Politeness) {
+	c.politeness = p
+}
+
+// schedule spaces the fetches of the hosts sharing it by their crawl delay
+type schedule struct {
+	mutex sync.Mutex
+	next  time.Time
+}
+
+// scheduleOf returns the schedule of host, resolved to addr, and its key
+func (c *Crawler) scheduleOf(host string, addr netip.Addr) (*schedule, string) {
+	key := host
+	switch {
+	case !addr.IsValid():
+	case c.politeness == Peraddress:
+		key = addr.Unmap().String()
+	case c.politeness == Persubnet:
+		key = subnetOf(addr).String()
+	}
+
+	c.hostsMutex.Lock()
+	defer c.hostsMutex.Unlock()
+	s, ok := c.schedules[key]
+	if !ok {
+		s = &schedule{}
+		c.schedules[key] = s
+	}
+	return s, key
+}
+
+// subnetOf returns the /24, or IPv6 /64, holding addr
+func subnetOf(addr netip.Addr) netip.Prefix {
+	addr = addr.Unmap()
+	bits := 24
+	if addr.Is6() {
+		bits = 64
+	}
+	subnet, _ := addr.Prefix(bits)
+	return subnet
+}
@@ -0,0 +1,75 @@
+// Package pool recycles byte buffers in power-of-two size classes, so page
+// bodies do not have to be allocated afresh for every fetch.
+package pool
+
+import (
+	"io"
+	"math/bits"
+	"sync"
+)
+
+// Buffers beyond the largest class are dropped rather than pooled, so one
+// huge body does not stay pinned in the pool
+const (
+	minshift = 12 // 4 KiB
+	maxshift = 22 // 4 MiB
+)
+
+var classes [maxshift - minshift + 1]sync.Pool
+
+// class returns the smallest class holding size bytes
+func class(size int) int {
+	if size <= 1<<minshift {
+		return 0
+	}
+	return bits.Len(uint(size-1)) - minshift
+}
+
+// Get returns an empty buffer with a capacity of at least size. Buffers
+// above the largest class are allocated and not recycled.
+func Get(size int) *[]byte {
+	c := class(size)
+	if c >= len(classes) {
+		b := make([]byte, 0, size)
+		return &b
+	}
+	if p, ok := classes[c].Get().(*[]byte); ok {
+		*p = (*p)[:0]
+		return p
+	}
+	b := make([]byte, 0, 1<<(c+minshift))
+	return &b
+}
+
+// Put recycles a buffer obtained from Get. The buffer must not be used
+// afterwards.
+func Put(p *[]byte) {
+	c := bits.Len(uint(cap(*p))) - 1 - minshift
+	if c < 0 || c >= len(classes) {
+		return
+	}
+	classes[c].Put(p)
+}
+
+// ReadAll reads r to the end into a pooled buffer sized from hint. The
+// caller returns the buffer with Put once done with its content.
+func ReadAll(r io.Reader, hint int) (*[]byte, error) {
+	p := Get(max(hint+1, 1<<minshift))
+	for {
+		b := *p
+		if len(b) == cap(b) {
+			bigger := Get(2 * cap(b))
+			*bigger = append(*bigger, b...)
+			Put(p)
+			p, b = bigger, *bigger
+		}
+		n, err := r.Read(b[len(b):cap(b)])
+		*p = b[:len(b)+n]
+		if err == io.EOF {
+			return p, nil
+		}
+		if err != nil {
+			return p, err
+		}
+	}
+}
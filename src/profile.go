@@ -0,0 +1,25 @@
+package crawler
+
+import (
+	"packages/src/profiling"
+)
+
+// SetProfiler makes the crawler capture profiles with capturer when fewer
+// than minRate pages per second are fetched or the fetch rate halves, and
+// ahead of the crawl timeout so the capture covers its last window. Crawl
+// phases are tagged with pprof labels for host and phase (robots, fetch,
+// parse, dedup) from then on.
+func (c *Crawler) SetProfiler(capturer *profiling.Capturer, minRate float64) {
+	c.capturer = capturer
+	c.minRate = minRate
+}
+
+// phase runs f under the profiling labels of host and phase when a profiler
+// is set
+func (c *Crawler) phase(host, phase string, f func()) {
+	if c.capturer == nil {
+		f()
+		return
+	}
+	profiling.Do(host, phase, f)
+}
@@ -0,0 +1,211 @@
+// Package profiling captures CPU, heap and execution-trace profiles when a
+// crawl runs slow.
+package profiling
+
+import (
+	"context"
+	"errors"
+	"fmt"
+	"os"
+	"path/filepath"
+	"runtime"
+	"runtime/pprof"
+	"runtime/trace"
+	"sync"
+	"time"
+)
+
+const (
+	dropratio      = 0.5 // of the trailing rate below which throughput dropped
+	baselineweight = 0.2 // of each window in the trailing rate
+)
+
+// ErrBusy is returned when a capture is already running
+var ErrBusy = errors.New("profiling: capture in progress")
+
+// Capturer writes profile captures into a directory. Only one capture runs at
+// a time since CPU profiles and traces are process wide.
+type Capturer struct {
+	dir      string
+	window   time.Duration
+	cooldown time.Duration
+	mutex    sync.Mutex
+	running  *recording // nil when idle
+	last     time.Time
+	done     sync.WaitGroup
+}
+
+// recording is a running capture
+type recording struct {
+	cut   chan struct{} // closed to end the capture before its window
+	ended chan struct{} // closed once its files are written
+	once  sync.Once
+}
+
+func (r *recording) stop() {
+	r.once.Do(func() { close(r.cut) })
+}
+
+// NewCapturer creates a new Capturer struct recording CPU profiles and traces
+// over window. Captures are at least cooldown apart.
+func NewCapturer(dir string, window, cooldown time.Duration) *Capturer {
+	return &Capturer{
+		dir:      dir,
+		window:   window,
+		cooldown: cooldown,
+	}
+}
+
+// Window returns the duration of the CPU profile and trace of a capture
+func (c *Capturer) Window() time.Duration {
+	return c.window
+}
+
+// Capture starts a capture in the background: a heap profile right away, and
+// a CPU profile and execution trace over the window. The files are named
+// after the start time and reason.
+func (c *Capturer) Capture(reason string) error {
+	return c.capture(reason, c.window, false)
+}
+
+// capture starts a capture over window. A preempting capture cuts short the
+// one running, keeping what it recorded, and ignores the cooldown.
+func (c *Capturer) capture(reason string, window time.Duration, preempt bool) error {
+	c.mutex.Lock()
+	for preempt && c.running != nil {
+		running := c.running
+		running.stop()
+		c.mutex.Unlock()
+		<-running.ended
+		c.mutex.Lock()
+	}
+	if c.running != nil || (!preempt && !c.last.IsZero() && time.Since(c.last) < c.cooldown) {
+		c.mutex.Unlock()
+		return ErrBusy
+	}
+	r := &recording{cut: make(chan struct{}), ended: make(chan struct{})}
+	c.running = r
+	c.last = time.Now()
+	c.mutex.Unlock()
+
+	prefix := filepath.Join(c.dir, fmt.Sprintf("%s-%s", c.last.Format("20060102T150405"), reason))
+	c.done.Add(1)
+	go func() {
+		defer c.done.Done()
+		defer func() {
+			c.mutex.Lock()
+			c.running = nil
+			c.mutex.Unlock()
+			close(r.ended)
+		}()
+		c.record(prefix, window, r.cut)
+	}()
+	return nil
+}
+
+// Wait blocks until the running capture, if any, is written
+func (c *Capturer) Wait() {
+	c.done.Wait()
+}
+
+func (c *Capturer) record(prefix string, window time.Duration, cut <-chan struct{}) {
+	if err := os.MkdirAll(c.dir, 0o755); err != nil {
+		return
+	}
+
+	if heap, err := os.Create(prefix + "-heap.pprof"); err == nil {
+		runtime.GC()
+		pprof.WriteHeapProfile(heap)
+		heap.Close()
+	}
+
+	cpu, err := os.Create(prefix + "-cpu.pprof")
+	if err != nil {
+		return
+	}
+	defer cpu.Close()
+	if err := pprof.StartCPUProfile(cpu); err != nil {
+		return
+	}
+	defer pprof.StopCPUProfile()
+
+	out, err := os.Create(prefix + "-trace.out")
+	if err != nil {
+		return
+	}
+	defer out.Close()
+	if err := trace.Start(out); err != nil {
+		return
+	}
+	defer trace.Stop()
+
+	timer := time.NewTimer(window)
+	defer timer.Stop()
+	select {
+	case <-timer.C:
+	case <-cut:
+	}
+}
+
+// Watch samples progress every window and captures when the rate of the
+// window falls below minRate units per second, or below dropratio of the
+// trailing rate of the windows before it. It also captures once over the
+// last window before timeout, the capture being shortened to the timeout
+// when it is longer than that. That capture takes priority: it cuts short a
+// slow or drop capture still running, and ignores the cooldown. A zero
+// minRate or timeout disables that trigger. The returned function stops
+// watching.
+func (c *Capturer) Watch(progress func() int64, minRate float64, timeout time.Duration) (stop func()) {
+	quit := make(chan struct{})
+	go func() {
+		ticker := time.NewTicker(c.window)
+		defer ticker.Stop()
+
+		var deadlineC <-chan time.Time
+		window := min(c.window, timeout)
+		if timeout > 0 {
+			timer := time.NewTimer(timeout - window)
+			defer timer.Stop()
+			deadlineC = timer.C
+		}
+
+		previous := progress()
+		var baseline float64 // trailing rate, zero until a window made progress
+		for {
+			select {
+			case <-quit:
+				return
+			case <-deadlineC:
+				c.capture("timeout", window, true)
+			case <-ticker.C:
+				current := progress()
+				rate := float64(current-previous) / c.window.Seconds()
+				previous = current
+				switch {
+				case minRate > 0 && rate < minRate:
+					c.Capture("slow")
+				case rate < dropratio*baseline:
+					c.Capture("drop")
+				}
+				if baseline == 0 {
+					baseline = rate
+				} else {
+					baseline += baselineweight * (rate - baseline)
+				}
+			}
+		}
+	}()
+
+	var once sync.Once
+	return func() {
+		once.Do(func() { close(quit) })
+	}
+}
+
+// Do runs f tagged with pprof labels for host and crawl phase, inside an
+// execution-trace region named after the phase.
+func Do(host, phase string, f func()) {
+	pprof.Do(context.Background(), pprof.Labels("host", host, "phase", phase), func(ctx context.Context) {
+		trace.WithRegion(ctx, phase, f)
+	})
+}
@@ -0,0 +1,38 @@
+package profiling
+
+import (
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+func TestPreemptingCapture(t *testing.T) {
+	dir := t.TempDir()
+	c := NewCapturer(dir, time.Minute, time.Hour)
+	if err := c.Capture("slow"); err != nil {
+		t.Fatal(err)
+	}
+	if err := c.Capture("drop"); err != ErrBusy {
+		t.Fatalf("second capture: %v, want ErrBusy", err)
+	}
+
+	start := time.Now()
+	if err := c.capture("timeout", 10*time.Millisecond, true); err != nil {
+		t.Fatalf("preempting capture: %v", err)
+	}
+	c.Wait()
+	if elapsed := time.Since(start); elapsed > 10*time.Second {
+		t.Errorf("the slow capture ran its window out, %v", elapsed)
+	}
+	for _, reason := range []string{"slow", "timeout"} {
+		files, _ := filepath.Glob(filepath.Join(dir, "*-"+reason+"-cpu.pprof"))
+		if len(files) != 1 {
+			t.Errorf("%d CPU profiles of the %s capture, want 1", len(files), reason)
+			continue
+		}
+		if info, err := os.Stat(files[0]); err != nil || info.Size() == 0 {
+			t.Errorf("empty CPU profile %s", files[0])
+		}
+	}
+}
@@ -0,0 +1,39 @@
+package crawler
+
+import (
+	"packages/src/fetcher"
+	"time"
+)
+
+// SetRetrypolicy replaces the default policy the crawler retries transient
+// fetch failures with. A failed entry goes back to the frontier, its host
+// parked for the backoff, so the retry waits for the crawl delay and the
+// rate limits like any fetch. Fetches are only hedged on hosts without a
+// crawl delay or rate limit.
+func (c *Crawler) SetRetrypolicy(p fetcher.Retrypolicy) {
+	p.Attempts = max(p.Attempts, 1)
+	c.retries = p
+}
+
+// hedge returns the hedge delay of the fetches of host, zero for none
+func (c *Crawler) hedge(host *hoststate) time.Duration {
+	if !host.hedges() {
+		return 0
+	}
+	return c.retries.Hedge
+}
+
+// retry hands the entry of a fetch that failed with err back to the
+// frontier, parking its host for the backoff, unless the failure is final
+// or the entry is out of tries. It reports whether it did.
+func (c *Crawler) retry(job *pagejob, err error) bool {
+	entry := job.entry
+	if entry.tries+1 >= c.retries.Attempts || !fetcher.Transient(err) {
+		return false
+	}
+	entry.tries++
+	c.metrics.retries.Inc()
+	job.page.Release()
+	c.frontier.Defer(entry, c.retries.Delay(entry.tries, err))
+	return true
+}
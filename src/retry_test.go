@@ -0,0 +1,61 @@
+package crawler
+
+import (
+	"context"
+	"net/http"
+	"net/http/httptest"
+	"packages/src/fetcher"
+	"sync"
+	"testing"
+	"time"
+)
+
+func TestRetryWaitsForCrawlDelay(t *testing.T) {
+	const delay = 100 * time.Millisecond
+	var (
+		mutex    sync.Mutex
+		requests []time.Time
+	)
+	server := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		if r.URL.Path == "/robots.txt" {
+			w.Write([]byte("User-agent: *\nCrawl-delay: 0.1\n"))
+			return
+		}
+		mutex.Lock()
+		requests = append(requests, time.Now())
+		tries := len(requests)
+		mutex.Unlock()
+		// Slow enough for a hedge, had the crawl delay allowed one
+		time.Sleep(20 * time.Millisecond)
+		if tries < 3 {
+			http.Error(w, "try again", http.StatusServiceUnavailable)
+			return
+		}
+		w.Header().Set("Content-Type", "text/html")
+		w.Write([]byte("<p>done</p>"))
+	}))
+	defer server.Close()
+
+	settings := NewCrawlersettings(time.Second, 10*time.Second, 0, 1, 1, fetcher.Hrefparser{})
+	c := NewCrawler(settings, fetcher.NewHttpfetcher(server.Client(), fetcher.Hrefparser{}, "test"), NewMemorycache())
+	c.SetRetrypolicy(fetcher.Retrypolicy{Attempts: 3, Backoff: time.Millisecond,
+		MaxBackoff: time.Millisecond, Hedge: time.Millisecond})
+	results := make(chan *Parsedresults)
+	go c.Crawl(context.Background(), []string{server.URL + "/"}, results)
+	pages := 0
+	for res := range results {
+		pages++
+		res.Release()
+	}
+
+	mutex.Lock()
+	defer mutex.Unlock()
+	if pages != 1 || len(requests) != 3 {
+		t.Fatalf("%d pages from %d requests, want 1 page from 3", pages, len(requests))
+	}
+	for i := 1; i < len(requests); i++ {
+		if gap := requests[i].Sub(requests[i-1]); gap < delay {
+			t.Errorf("try %d followed the previous one by %v, within the crawl delay", i+1, gap)
+		}
+	}
+}
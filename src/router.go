@@ -0,0 +1,74 @@
+package crawler
+
+import (
+	"net/url"
+)
+
+// Router spreads hosts over the nodes of a crawl cluster. Each host is owned
+// by exactly one node, which alone fetches it and enforces its crawl delay.
+type Router interface {
+	// Owns reports whether host is crawled by this node
+	Owns(host string) bool
+	// Route hands a link of a host owned by another node to its owner
+	Route(link *url.URL, depth int)
+}
+
+// SetRouter turns the crawler into a cluster node. Links leaving the domain
+// of their page are followed and sent to the node owning their host, and
+// the crawl keeps waiting for routed links until it times out or Stop is
+// called.
+func (c *Crawler) SetRouter(r Router) {
+	c.router = r
+	c.frontier.SetKeepalive(true)
+}
+
+// Admit queues a link of a host owned by this node unless it was seen
+// before. Its robots.txt rules are checked when it is fetched.
+func (c *Crawler) Admit(link *url.URL, depth int) {
+	c.checkpoints.begin()
+	defer c.checkpoints.end()
+	c.admit(link, depth)
+}
+
+func (c *Crawler) admit(link *url.URL, depth int) {
+	base := baseOf(link).String()
+	if c.cache.Contains(base, link.String()) {
+		c.metrics.verdicts[Visited].Inc()
+		return
+	}
+	c.cache.Set(base, link.String())
+	c.enqueue(link, depth)
+}
+
+// Release removes the queued links of the hosts owns no longer claims, so
+// they can be routed to their new owner
+func (c *Crawler) Release(owns func(host string) bool) []Entry {
+	entries := c.frontier.Extract(owns)
+	for _, e := range entries {
+		c.checkpoints.complete(e.URL)
+	}
+	return entries
+}
+
+// Stop ends the crawl, aborting the fetches in flight
+func (c *Crawler) Stop() {
+	c.frontier.Stop()
+	if cancel := c.cancel.Load(); cancel != nil {
+		(*cancel)()
+	}
+}
+
+// Idle reports whether the crawler has nothing queued or in flight
+func (c *Crawler) Idle() bool {
+	return c.frontier.Idle()
+}
+
+// follow queues a link found on another host, or routes it to its owner
+func (c *Crawler) follow(link *url.URL, depth int) {
+	if c.router.Owns(link.Host) {
+		c.admit(link, depth)
+		return
+	}
+	c.metrics.routed.Inc()
+	c.router.Route(link, depth)
+}
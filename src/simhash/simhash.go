@@ -0,0 +1,157 @@
+// Package simhash fingerprints documents so that near-duplicates differ in
+// only a few bits, and indexes fingerprints for Hamming-distance lookups.
+package simhash
+
+import (
+	"math/bits"
+	"sync"
+)
+
+// Hasher accumulates weighted feature hashes into a 64-bit SimHash
+type Hasher struct {
+	counts   [64]int32
+	features int
+}
+
+// Add accounts for one feature hash
+func (h *Hasher) Add(feature uint64) {
+	for i := range h.counts {
+		if feature&(1<<uint(i)) != 0 {
+			h.counts[i]++
+		} else {
+			h.counts[i]--
+		}
+	}
+	h.features++
+}
+
+// Features returns the number of features added
+func (h *Hasher) Features() int {
+	return h.features
+}
+
+// Sum returns the fingerprint of the features added so far
+func (h *Hasher) Sum() uint64 {
+	var sum uint64
+	for i, c := range h.counts {
+		if c > 0 {
+			sum |= 1 << uint(i)
+		}
+	}
+	return sum
+}
+
+// Reset clears the hasher for reuse
+func (h *Hasher) Reset() {
+	*h = Hasher{}
+}
+
+// Shingler turns a stream of words into hashes of overlapping word triples
+// and adds them to a Hasher
+type Shingler struct {
+	Hasher *Hasher
+	window [3]uint64
+	words  int
+}
+
+// Word adds the word with hash w, completing a shingle with the two
+// previous words
+func (s *Shingler) Word(w uint64) {
+	s.window[0], s.window[1], s.window[2] = s.window[1], s.window[2], w
+	s.words++
+	if s.words >= len(s.window) {
+		s.Hasher.Add(mix(s.window[0]*31*31 + s.window[1]*31 + s.window[2]))
+	}
+}
+
+// mix is the splitmix64 finalizer
+func mix(x uint64) uint64 {
+	x ^= x >> 30
+	x *= 0xbf58476d1ce4e5b9
+	x ^= x >> 27
+	x *= 0x94d049bb133111eb
+	return x ^ x>>31
+}
+
+// Distance returns the number of differing bits between two fingerprints
+func Distance(a, b uint64) int {
+	return bits.OnesCount64(a ^ b)
+}
+
+// Index finds fingerprints within a Hamming distance of each other. The
+// fingerprint is cut into distance+1 blocks, one table per block: by the
+// pigeonhole principle a near-duplicate matches at least one block exactly,
+// so only the fingerprints sharing a block are compared.
+type Index struct {
+	distance int
+	shift    []uint
+	width    uint
+	rwMutex  sync.RWMutex
+	tables   []map[uint64][]uint64
+	size     int
+}
+
+// NewIndex creates a new Index struct matching fingerprints at most
+// distance bits apart
+func NewIndex(distance int) *Index {
+	blocks := distance + 1
+	idx := &Index{
+		distance: distance,
+		width:    uint(64 / blocks),
+		tables:   make([]map[uint64][]uint64, blocks),
+	}
+	for i := range idx.tables {
+		idx.tables[i] = make(map[uint64][]uint64)
+		idx.shift = append(idx.shift, uint(i)*idx.width)
+	}
+	return idx
+}
+
+func (idx *Index) block(fp uint64, i int) uint64 {
+	width := idx.width
+	if i == len(idx.tables)-1 {
+		width = 64 - idx.shift[i]
+	}
+	return fp >> idx.shift[i] & (1<<width - 1)
+}
+
+// Near reports whether a fingerprint within the distance is indexed
+func (idx *Index) Near(fp uint64) bool {
+	idx.rwMutex.RLock()
+	defer idx.rwMutex.RUnlock()
+	return idx.near(fp)
+}
+
+func (idx *Index) near(fp uint64) bool {
+	for i, table := range idx.tables {
+		for _, other := range table[idx.block(fp, i)] {
+			if Distance(fp, other) <= idx.distance {
+				return true
+			}
+		}
+	}
+	return false
+}
+
+// Insert adds fp unless a near-duplicate is already indexed, and reports
+// whether it was added
+func (idx *Index) Insert(fp uint64) bool {
+	idx.rwMutex.Lock()
+	defer idx.rwMutex.Unlock()
+	if idx.near(fp) {
+		return false
+	}
+	for i, table := range idx.tables {
+		key := idx.block(fp, i)
+		table[key] = append(table[key], fp)
+	}
+	idx.size++
+	return true
+}
+
+// Len returns the number of indexed fingerprints
+func (idx *Index) Len() int {
+	idx.rwMutex.RLock()
+	defer idx.rwMutex.RUnlock()
+	return idx.size
+}
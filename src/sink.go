@@ -0,0 +1,99 @@
+package crawler
+
+import (
+	"packages/src/diskio"
+	"sync"
+	"unicode/utf8"
+)
+
+// Sink writes results to a file as JSON lines, {"URL":...,"Links":[...]}.
+// The lines are gathered in large blocks written asynchronously by diskio,
+// so a consumer only waits on the disk when every block is in flight. It is
+// safe for concurrent use.
+type Sink struct {
+	mutex  sync.Mutex
+	writer *diskio.Writer
+	line   []byte
+	bytes  int64
+}
+
+// NewSink creates or truncates the file at path and returns a Sink to it
+func NewSink(path string, options diskio.Options) (*Sink, error) {
+	w, err := diskio.Create(path, options)
+	if err != nil {
+		return nil, err
+	}
+	return &Sink{writer: w}, nil
+}
+
+// Write appends the line of res
+func (s *Sink) Write(res *Parsedresults) error {
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
+	s.line = append(s.line[:0], `{"URL":`...)
+	s.line = appendJSONString(s.line, res.URL)
+	s.line = append(s.line, `,"Links":[`...)
+	for i, link := range res.Links {
+		if i > 0 {
+			s.line = append(s.line, ',')
+		}
+		s.line = appendJSONString(s.line, link)
+	}
+	s.line = append(s.line, "]}\n"...)
+	n, err := s.writer.Write(s.line)
+	s.bytes += int64(n)
+	return err
+}
+
+// Backend returns the backend the writes are submitted to
+func (s *Sink) Backend() diskio.Backend {
+	return s.writer.Backend()
+}
+
+// Bytes returns the bytes written so far
+func (s *Sink) Bytes() int64 {
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
+	return s.bytes
+}
+
+// Close writes the lines buffered and closes the file
+func (s *Sink) Close() error {
+	s.mutex.Lock()
+	defer s.mutex.Unlock()
+	return s.writer.Close()
+}
+
+// appendJSONString appends s quoted as a JSON string, invalid UTF-8 being
+// replaced as encoding/json does
+func appendJSONString(b []byte, s string) []byte {
+	const hex = "0123456789abcdef"
+	b = append(b, '"')
+	start := 0
+	for i := 0; i < len(s); {
+		c := s[i]
+		if c >= 0x20 && c != '"' && c != '\\' && c < utf8.RuneSelf {
+			i++
+			continue
+		}
+		if c >= utf8.RuneSelf {
+			if r, size := utf8.DecodeRuneInString(s[i:]); r != utf8.RuneError || size != 1 {
+				i += size
+				continue
+			}
+		}
+		b = append(b, s[start:i]...)
+		switch {
+		case c == '"' || c == '\\':
+			b = append(b, '\\', c)
+		case c < 0x20:
+			b = append(b, '\\', 'u', '0', '0', hex[c>>4], hex[c&0xf])
+		default:
+			b = append(b, "\ufffd"...)
+		}
+		i++
+		start = i
+	}
+	b = append(b, s[start:]...)
+	return append(b, '"')
+}
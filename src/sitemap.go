@@ -0,0 +1,143 @@
+package crawler
+
+import (
+	"context"
+	"net/http"
+	"net/url"
+	"packages/src/fetcher"
+	"sort"
+	"time"
+)
+
+const (
+	sitemapworkers  = 4  // sitemaps read at the same time
+	sitemapsperhost = 16 // sitemaps read per host, index files included
+)
+
+// SetSitemaps makes the crawler read the sitemaps listed in the robots.txt
+// of each host it visits and queue their URLs in bulk, most recently
+// modified first. URLs whose lastmod is before since are skipped as
+// unchanged; a zero since keeps them all.
+func (c *Crawler) SetSitemaps(since time.Time) {
+	c.sitemaps = true
+	c.sitemapSince = since
+	c.sitemapSlots = make(chan struct{}, sitemapworkers)
+}
+
+// sitemapurl is a page listed by a sitemap
+type sitemapurl struct {
+	link    *url.URL
+	lastmod time.Time
+}
+
+// ingest reads the sitemaps of a host, following sitemap indexes, in the
+// background. The frontier is held until it is done.
+func (c *Crawler) ingest(ctx context.Context, host *hoststate, base *url.URL, locations []string) {
+	c.frontier.Hold()
+	go func() {
+		defer c.frontier.Unhold()
+		select {
+		case c.sitemapSlots <- struct{}{}:
+			defer func() { <-c.sitemapSlots }()
+		case <-ctx.Done():
+			return
+		}
+
+		seen := make(map[string]bool)
+		for read := 0; len(locations) > 0 && read < sitemapsperhost; read++ {
+			loc := locations[0]
+			locations = locations[1:]
+			if seen[loc] {
+				continue
+			}
+			seen[loc] = true
+			if _, ok := host.wait(ctx); !ok {
+				return
+			}
+
+			var pages []sitemapurl
+			c.phase(base.Host, "sitemap", func() {
+				var nested []string
+				pages, nested = c.readSitemap(ctx, base, loc)
+				locations = append(locations, nested...)
+			})
+			c.queueSitemap(host, base, pages)
+		}
+	}()
+}
+
+// readSitemap fetches the sitemap at loc and returns the pages it lists on
+// the host of base that changed since the configured time, and the sitemaps
+// it lists when it is an index. The sitemap itself may be on any host, as
+// listing it in robots.txt vouches for it.
+func (c *Crawler) readSitemap(ctx context.Context, base *url.URL, loc string) (pages []sitemapurl, nested []string) {
+	if link, err := url.Parse(loc); err != nil || link.Host == "" {
+		return nil, nil
+	}
+	ctx, cancel := context.WithTimeout(ctx, c.settings.fetchtimeout)
+	defer cancel()
+	_, resp, err := c.fetcher.Fetch(fetcher.Paced(ctx, 0), loc)
+	if err != nil {
+		return nil, nil
+	}
+	defer resp.Body.Close()
+	if resp.StatusCode != http.StatusOK {
+		return nil, nil
+	}
+	c.metrics.sitemaps.Inc()
+
+	// Entries decoded before an error are kept
+	fetcher.ParseSitemap(ctx, resp.Body, func(e fetcher.Sitemapentry) error {
+		if e.Index {
+			nested = append(nested, e.Loc)
+			return nil
+		}
+		if !e.Lastmod.IsZero() && e.Lastmod.Before(c.sitemapSince) {
+			c.metrics.sitemapURLs[sitemapUnchanged].Inc()
+			return nil
+		}
+		// A sitemap may only list the URLs of the host whose robots.txt
+		// lists it
+		link, err := url.Parse(e.Loc)
+		if err != nil || link.Host != base.Host {
+			c.metrics.sitemapURLs[sitemapRejected].Inc()
+			return nil
+		}
+		link.Fragment, link.RawFragment = "", ""
+		pages = append(pages, sitemapurl{link, e.Lastmod})
+		return nil
+	})
+	return pages, nested
+}
+
+// queueSitemap pushes the pages passing the crawling rules of host to the
+// frontier in one batch, most recently modified first, one level below the
+// root
+func (c *Crawler) queueSitemap(host *hoststate, base *url.URL, pages []sitemapurl) {
+	sort.SliceStable(pages, func(i, j int) bool {
+		return pages[i].lastmod.After(pages[j].lastmod)
+	})
+	links := make([]*url.URL, len(pages))
+	for i, p := range pages {
+		links[i] = p.link
+	}
+	c.checkpoints.begin()
+	defer c.checkpoints.end()
+	accepted := host.rules.AllowedBatch(links, nil, nil)
+	links = links[:0]
+	modified := make([]time.Time, 0, len(pages))
+	for i, p := range pages {
+		if accepted[i/64]&(1<<(i%64)) != 0 {
+			links = append(links, p.link)
+			modified = append(modified, p.lastmod)
+		}
+	}
+	c.metrics.sitemapURLs[sitemapRejected].Add(uint64(len(pages) - len(links)))
+
+	if n := c.frontier.Pushmodified(links, modified, 1); n > 0 {
+		c.checkpoints.enqueueBatch(links, modified, 1)
+		c.metrics.sitemapURLs[sitemapQueued].Add(uint64(n))
+	} else {
+		c.metrics.pruned.Add(uint64(len(links)))
+	}
+}
@@ -0,0 +1,47 @@
+package crawler
+
+import (
+	"context"
+	"fmt"
+	"net/http"
+	"net/http/httptest"
+	"packages/src/fetcher"
+	"testing"
+	"time"
+)
+
+func TestSitemapOnAnotherHost(t *testing.T) {
+	var site *httptest.Server // set before the first request
+	sitemaps := httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		fmt.Fprintf(w, `<urlset><url><loc>%s/listed</loc></url><url><loc>http://%s/foreign</loc></url></urlset>`,
+			site.URL, r.Host)
+	}))
+	defer sitemaps.Close()
+	site = httptest.NewServer(http.HandlerFunc(func(w http.ResponseWriter, r *http.Request) {
+		if r.URL.Path == "/robots.txt" {
+			fmt.Fprintf(w, "User-agent: *\nSitemap: %s/sitemap.xml\n", sitemaps.URL)
+			return
+		}
+		w.Header().Set("Content-Type", "text/html")
+		w.Write([]byte("<p>page</p>"))
+	}))
+	defer site.Close()
+
+	settings := NewCrawlersettings(time.Second, 10*time.Second, 0, 1, 1, fetcher.Hrefparser{})
+	c := NewCrawler(settings, fetcher.NewHttpfetcher(http.DefaultClient, fetcher.Hrefparser{}, "test"), NewMemorycache())
+	c.SetSitemaps(time.Time{})
+	results := make(chan *Parsedresults)
+	go c.Crawl(context.Background(), []string{site.URL + "/"}, results)
+	fetched := make(map[string]bool)
+	for res := range results {
+		fetched[res.URL] = true
+		res.Release()
+	}
+
+	if !fetched[site.URL+"/listed"] {
+		t.Errorf("fetched %v, missing the page listed by the sitemap of another host", fetched)
+	}
+	if fetched[sitemaps.URL+"/foreign"] {
+		t.Errorf("fetched %s, listed by the sitemap of a host other than its own", sitemaps.URL+"/foreign")
+	}
+}
@@ -0,0 +1,192 @@
+package crawler
+
+import (
+	"bytes"
+	"compress/flate"
+	"encoding/binary"
+	"errors"
+	"fmt"
+	"io"
+	"net/url"
+	"os"
+	"path/filepath"
+	"time"
+)
+
+const (
+	spillblocksize          = 256      // entries per compressed block
+	defaultspillsegmentsize = 64 << 20 // bytes per segment file
+)
+
+var errCorruptBlock = errors.New("crawler: corrupt spill block")
+
+// segment is an append-only file of compressed blocks. It is removed once it
+// is full and every block in it has been read back.
+type segment struct {
+	file   *os.File
+	size   int64
+	live   int
+	sealed bool
+}
+
+// spillblock locates a compressed block of entries in a segment
+type spillblock struct {
+	segment *segment
+	offset  int64
+	length  int
+	count   int
+}
+
+// spillstore appends the frontier tails of all hosts to shared, sequential
+// segment files. write and release are called with the frontier lock held,
+// read is safe to call concurrently.
+type spillstore struct {
+	dir         string
+	segmentSize int64
+	sequence    int
+	current     *segment
+	segments    map[*segment]struct{}
+	raw         []byte
+	compressed  bytes.Buffer
+	writer      *flate.Writer
+}
+
+func newSpillstore(dir string, segmentSize int64) (*spillstore, error) {
+	dir, err := os.MkdirTemp(dir, "frontier-")
+	if err != nil {
+		return nil, err
+	}
+	writer, _ := flate.NewWriter(nil, flate.BestSpeed)
+	return &spillstore{
+		dir:         dir,
+		segmentSize: segmentSize,
+		segments:    make(map[*segment]struct{}),
+		writer:      writer,
+	}, nil
+}
+
+func (s *spillstore) rotate() error {
+	if s.current != nil {
+		s.current.sealed = true
+		s.collect(s.current)
+	}
+	s.sequence++
+	file, err := os.Create(filepath.Join(s.dir, fmt.Sprintf("segment-%06d.spill", s.sequence)))
+	if err != nil {
+		s.current = nil
+		return err
+	}
+	s.current = &segment{file: file}
+	s.segments[s.current] = struct{}{}
+	return nil
+}
+
+func (s *spillstore) write(entries []Entry) (*spillblock, error) {
+	if s.current == nil || s.current.size >= s.segmentSize {
+		if err := s.rotate(); err != nil {
+			return nil, err
+		}
+	}
+
+	s.raw = s.raw[:0]
+	for _, e := range entries {
+		link := e.URL.String()
+		s.raw = binary.AppendUvarint(s.raw, uint64(e.Depth))
+		s.raw = binary.AppendVarint(s.raw, e.Discovered.UnixNano())
+		s.raw = binary.AppendVarint(s.raw, unixNano(e.Modified))
+		s.raw = binary.AppendUvarint(s.raw, uint64(len(link)))
+		s.raw = append(s.raw, link...)
+	}
+	s.compressed.Reset()
+	s.writer.Reset(&s.compressed)
+	s.writer.Write(s.raw)
+	s.writer.Close()
+
+	// At the offset recorded, so that a partial write cannot shift the
+	// blocks written after it
+	n, err := s.current.file.WriteAt(s.compressed.Bytes(), s.current.size)
+	if err != nil {
+		// The segment takes no more blocks, the next write starts another
+		s.current.sealed = true
+		s.collect(s.current)
+		s.current = nil
+		return nil, err
+	}
+	b := &spillblock{segment: s.current, offset: s.current.size, length: n, count: len(entries)}
+	s.current.size += int64(n)
+	s.current.live++
+	return b, nil
+}
+
+func (s *spillstore) read(b *spillblock) ([]Entry, error) {
+	compressed := make([]byte, b.length)
+	if _, err := b.segment.file.ReadAt(compressed, b.offset); err != nil {
+		return nil, err
+	}
+	raw, err := io.ReadAll(flate.NewReader(bytes.NewReader(compressed)))
+	if err != nil {
+		return nil, err
+	}
+
+	entries := make([]Entry, 0, b.count)
+	for len(raw) > 0 {
+		depth, n := binary.Uvarint(raw)
+		if n <= 0 {
+			return entries, errCorruptBlock
+		}
+		raw = raw[n:]
+		discovered, n := binary.Varint(raw)
+		if n <= 0 {
+			return entries, errCorruptBlock
+		}
+		raw = raw[n:]
+		modified, n := binary.Varint(raw)
+		if n <= 0 {
+			return entries, errCorruptBlock
+		}
+		raw = raw[n:]
+		length, n := binary.Uvarint(raw)
+		if n <= 0 || uint64(len(raw)-n) < length {
+			return entries, errCorruptBlock
+		}
+		link, err := url.Parse(string(raw[n : n+int(length)]))
+		raw = raw[n+int(length):]
+		if err != nil {
+			continue
+		}
+		e := Entry{URL: link, Depth: int(depth), Discovered: time.Unix(0, discovered)}
+		if modified != 0 {
+			e.Modified = time.Unix(0, modified)
+		}
+		entries = append(entries, e)
+	}
+	return entries, nil
+}
+
+// unixNano returns t in nanoseconds since the epoch, zero for the zero time
+func unixNano(t time.Time) int64 {
+	if t.IsZero() {
+		return 0
+	}
+	return t.UnixNano()
+}
+
+func (s *spillstore) release(b *spillblock) {
+	b.segment.live--
+	s.collect(b.segment)
+}
+
+func (s *spillstore) collect(seg *segment) {
+	if seg.sealed && seg.live == 0 {
+		seg.file.Close()
+		os.Remove(seg.file.Name())
+		delete(s.segments, seg)
+	}
+}
+
+func (s *spillstore) close() error {
+	for seg := range s.segments {
+		seg.file.Close()
+	}
+	return os.RemoveAll(s.dir)
+}
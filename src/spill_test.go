@@ -0,0 +1,137 @@
+package crawler
+
+import (
+	"fmt"
+	"os"
+	"testing"
+	"time"
+)
+
+func spillentries(t *testing.T, n int) []Entry {
+	discovered := time.Unix(1700000000, 123)
+	entries := make([]Entry, n)
+	for i := range entries {
+		entries[i] = Entry{
+			URL:        mustURL(t, fmt.Sprintf("http://host%d.com/path/%d?q=%%20%d", i%3, i, i)),
+			Depth:      i % 5,
+			Discovered: discovered.Add(time.Duration(i) * time.Second),
+		}
+		if i%2 == 0 {
+			entries[i].Modified = discovered.Add(-time.Duration(i) * time.Hour)
+		}
+	}
+	return entries
+}
+
+func TestSpillRoundTrip(t *testing.T) {
+	s, err := newSpillstore(t.TempDir(), 1024)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer s.close()
+
+	var (
+		blocks []*spillblock
+		wrote  [][]Entry
+	)
+	for i := 0; i < 8; i++ {
+		entries := spillentries(t, 10+i*40)
+		b, err := s.write(entries)
+		if err != nil {
+			t.Fatal(err)
+		}
+		blocks, wrote = append(blocks, b), append(wrote, entries)
+	}
+	if s.sequence < 2 {
+		t.Errorf("wrote %d segments, want the blocks to rotate them", s.sequence)
+	}
+
+	for i, b := range blocks {
+		read, err := s.read(b)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if len(read) != len(wrote[i]) || b.count != len(read) {
+			t.Fatalf("block %d read %d entries, want %d", i, len(read), len(wrote[i]))
+		}
+		for k, e := range read {
+			w := wrote[i][k]
+			if e.URL.String() != w.URL.String() || e.Depth != w.Depth ||
+				!e.Discovered.Equal(w.Discovered) || !e.Modified.Equal(w.Modified) || e.Modified.IsZero() != w.Modified.IsZero() {
+				t.Errorf("block %d entry %d read as %+v, want %+v", i, k, e, w)
+			}
+		}
+		s.release(b)
+	}
+
+	// Only the segment written last is left once every block is released
+	files, err := os.ReadDir(s.dir)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if len(files) != 1 || len(s.segments) != 1 {
+		t.Errorf("%d segment files and %d segments left, want the current one", len(files), len(s.segments))
+	}
+}
+
+func TestSpillCorruptBlock(t *testing.T) {
+	s, err := newSpillstore(t.TempDir(), defaultspillsegmentsize)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer s.close()
+	b, err := s.write(spillentries(t, 10))
+	if err != nil {
+		t.Fatal(err)
+	}
+	if _, err := s.current.file.WriteAt([]byte{0xff, 0xff, 0xff}, b.offset); err != nil {
+		t.Fatal(err)
+	}
+	if entries, err := s.read(b); err == nil && len(entries) == b.count {
+		t.Error("read a corrupt block without error")
+	}
+}
+
+func TestSpillWriteError(t *testing.T) {
+	s, err := newSpillstore(t.TempDir(), defaultspillsegmentsize)
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer s.close()
+	first := spillentries(t, 20)
+	b, err := s.write(first)
+	if err != nil {
+		t.Fatal(err)
+	}
+	// The segment becomes read-only, so the next write fails
+	seg := s.current
+	readonly, err := os.Open(seg.file.Name())
+	if err != nil {
+		t.Fatal(err)
+	}
+	seg.file.Close()
+	seg.file = readonly
+	if _, err := s.write(spillentries(t, 20)); err == nil {
+		t.Fatal("wrote to a read-only segment")
+	}
+
+	// The blocks written before and after the failure read back intact
+	second := spillentries(t, 30)
+	c, err := s.write(second)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if c.segment == seg {
+		t.Error("wrote again to the segment whose write failed")
+	}
+	for _, w := range []struct {
+		block   *spillblock
+		entries []Entry
+	}{{b, first}, {c, second}} {
+		read, err := s.read(w.block)
+		if err != nil || len(read) != len(w.entries) {
+			t.Errorf("read %d entries (%v), want %d", len(read), err, len(w.entries))
+		}
+		s.release(w.block)
+	}
+}
@@ -0,0 +1,418 @@
+package synthweb
+
+import (
+	"bufio"
+	"context"
+	"fmt"
+	"net/url"
+	"os"
+	crawler "packages/src"
+	"packages/src/cluster"
+	"packages/src/diskio"
+	"packages/src/fetcher"
+	"packages/src/linkgraph"
+	"packages/src/metrics"
+	"packages/src/profiling"
+	"packages/src/simhash"
+	"path/filepath"
+	"runtime"
+	"sort"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+// Report summarizes a benchmark crawl
+type Report struct {
+	Pages        int
+	Errors       int
+	Elapsed      time.Duration
+	PagesPerSec  float64
+	P50          time.Duration
+	P99          time.Duration
+	Allocs       uint64
+	AllocBytes   uint64
+	NumGC        uint32
+	GCPause      time.Duration
+	PeakRSS      uint64 // bytes of the process, zero when unknown
+	Stages       []crawler.Stagestats
+	Restored     crawler.Restored // state loaded from checkpoints, summed over nodes
+	Sink         string           // backend of the result sink, empty without one
+	SinkBytes    int64
+	GraphNodes   int // pages in the link graphs, zero without them
+	GraphBytes   int
+	GraphEvicted int // pages evicted from the link graphs
+}
+
+func (r Report) String() string {
+	perPage := func(v uint64) uint64 {
+		if r.Pages == 0 {
+			return 0
+		}
+		return v / uint64(r.Pages)
+	}
+	var b strings.Builder
+	fmt.Fprintf(&b, "pages=%d errors=%d elapsed=%s pages/sec=%.1f p50=%s p99=%s "+
+		"allocs/page=%d bytes/page=%d gc=%d gcpause=%s peakrss=%dMiB",
+		r.Pages, r.Errors, r.Elapsed.Round(time.Millisecond), r.PagesPerSec,
+		r.P50.Round(time.Microsecond), r.P99.Round(time.Microsecond),
+		perPage(r.Allocs), perPage(r.AllocBytes), r.NumGC, r.GCPause, r.PeakRSS>>20)
+	if r.Restored.Visited > 0 {
+		fmt.Fprintf(&b, "\nrestored visited=%d queued=%d hosts=%d in %s", r.Restored.Visited,
+			r.Restored.Queued, r.Restored.Hosts, r.Restored.Elapsed.Round(time.Millisecond))
+	}
+	if r.Sink != "" {
+		fmt.Fprintf(&b, "\nsink backend=%s bytes=%d MB/s=%.1f", r.Sink, r.SinkBytes,
+			float64(r.SinkBytes)/r.Elapsed.Seconds()/1e6)
+	}
+	if r.GraphNodes > 0 {
+		fmt.Fprintf(&b, "\nlinkgraph nodes=%d bytes=%d bytes/node=%.1f", r.GraphNodes, r.GraphBytes,
+			float64(r.GraphBytes)/float64(r.GraphNodes))
+		if r.GraphEvicted > 0 {
+			fmt.Fprintf(&b, " evicted=%d", r.GraphEvicted)
+		}
+	}
+	for _, s := range r.Stages {
+		fmt.Fprintf(&b, "\nstage=%s workers=%d busy=%.1f%% blocked=%.1f%%",
+			s.Name, s.Workers, 100*s.Utilization, 100*s.Blocked)
+	}
+	return b.String()
+}
+
+// timedfetcher records the fetch latency returned by the wrapped fetcher
+type timedfetcher struct {
+	crawler.Pagefetcher
+	mutex     sync.Mutex
+	latencies []time.Duration
+	errors    int
+}
+
+func (t *timedfetcher) Fetchlinks(ctx context.Context, link string) (time.Duration, []*url.URL, error) {
+	d, links, err := t.Pagefetcher.Fetchlinks(ctx, link)
+	t.record(d, err)
+	return d, links, err
+}
+
+func (t *timedfetcher) Fetchbody(ctx context.Context, link string, page *fetcher.Page) (time.Duration, error) {
+	d, err := t.Pagefetcher.Fetchbody(ctx, link, page)
+	t.record(d, err)
+	return d, err
+}
+
+func (t *timedfetcher) Parsepage(ctx context.Context, link string, page *fetcher.Page) error {
+	err := t.Pagefetcher.Parsepage(ctx, link, page)
+	if err != nil {
+		t.record(0, err)
+	}
+	return err
+}
+
+func (t *timedfetcher) record(d time.Duration, err error) {
+	t.mutex.Lock()
+	t.latencies = append(t.latencies, d)
+	if err != nil {
+		t.errors++
+	}
+	t.mutex.Unlock()
+}
+
+// Options enables optional instrumentation of a benchmark crawl
+type Options struct {
+	Registry   *metrics.Registry      // registers crawler and fetcher metrics
+	Capturer   *profiling.Capturer    // captures profiles of slow crawls
+	MinRate    float64                // pages/sec below which a crawl is slow
+	SpillDir   string                 // spills the frontier under this directory
+	Head       int                    // in-memory frontier entries per host when spilling
+	Checkpoint string                 // saves the crawl state under this directory, resuming the crawl it holds
+	Every      time.Duration          // interval between checkpoints
+	WAL        time.Duration          // commit interval of a write-ahead log of the checkpoints, zero for none
+	Sink       string                 // writes the results as JSON lines to this file
+	SinkIO     diskio.Options         // how the sink writes to disk
+	Nodes      int                    // crawlers forming a cluster on localhost
+	Exchange   cluster.Options        // link exchange tuning of the cluster
+	Simhash    int                    // near-duplicate distance in bits, negative disables
+	Traps      *crawler.Traplimits    // rejects URLs of runaway patterns
+	Retry      *fetcher.Retrypolicy   // replaces the default retry policy
+	Breakers   *crawler.Breakerlimits // parks hosts that keep failing
+	Budget     *crawler.Budget        // ranks the pages of each host by value and caps its fetches
+	Linkgraph  time.Duration          // ranks the pages by the importance of a link graph swept at this interval, zero for none
+	GraphLimit int                    // pages held by each link graph, the default when zero
+	Sitemaps   bool                   // queues the URLs listed by sitemaps
+	Deny       []string               // path extensions of the links not followed
+	Limits     *crawler.Ratelimits    // caps the fetch rate per host, address, subnet and overall
+	Polite     crawler.Politeness     // what the crawl delay spaces the fetches of
+	Since      time.Time              // skips sitemap URLs unchanged since then
+	Parsers    int                    // parse stage workers, GOMAXPROCS when zero
+	Filters    int                    // filter stage workers, GOMAXPROCS when zero
+}
+
+// Run crawls the whole farm from the root of every host and reports
+// throughput, fetch latency and allocation costs of the crawler. They cover
+// the whole process, serving the farm included unless it is remote. With more
+// than one node, the crawlers form a cluster on localhost and follow links
+// across hosts. Cancelling ctx ends the crawl early.
+func Run(ctx context.Context, farm *Farm, settings *crawler.Crawlersettings, options Options) (report Report, err error) {
+	client := farm.Client()
+	client.Timeout = settings.FetchTimeout()
+	httpfetcher := fetcher.NewHttpfetcher(client, settings.Parser(), "synthweb-bench")
+	timed := &timedfetcher{Pagefetcher: httpfetcher}
+
+	var crawlermetrics *crawler.Crawlermetrics
+	if options.Registry != nil {
+		httpfetcher.SetMetrics(fetcher.NewFetchmetrics(options.Registry))
+		crawlermetrics = crawler.NewCrawlermetrics(options.Registry)
+	}
+
+	var nearDups *simhash.Index
+	if options.Simhash >= 0 {
+		nearDups = simhash.NewIndex(options.Simhash)
+	}
+
+	crawlers := make([]*crawler.Crawler, max(options.Nodes, 1))
+	var graphs []*linkgraph.Graph
+	for i := range crawlers {
+		c := crawler.NewCrawler(settings, timed, crawler.NewMemorycache())
+		if nearDups != nil {
+			c.SetDuplicateindex(nearDups)
+		}
+		if options.Traps != nil {
+			c.SetTraplimits(*options.Traps)
+		}
+		if options.Retry != nil {
+			c.SetRetrypolicy(*options.Retry)
+		}
+		if options.Breakers != nil {
+			c.SetBreakers(*options.Breakers)
+		}
+		if options.Budget != nil {
+			c.SetBudget(*options.Budget)
+		}
+		if options.Linkgraph > 0 {
+			g := linkgraph.New()
+			if options.GraphLimit > 0 {
+				g.SetLimit(options.GraphLimit)
+			}
+			c.SetLinkgraph(g, options.Linkgraph)
+			graphs = append(graphs, g)
+		}
+		if options.Sitemaps {
+			c.SetSitemaps(options.Since)
+		}
+		c.SetResolver(farm)
+		c.SetPoliteness(options.Polite)
+		if options.Limits != nil {
+			c.SetRatelimits(*options.Limits)
+		}
+		if options.Deny != nil {
+			c.SetLinkfilter([]string{"http", "https"}, options.Deny)
+		}
+		if crawlermetrics != nil {
+			c.SetMetrics(crawlermetrics)
+		}
+		if options.Parsers > 0 || options.Filters > 0 {
+			parsers, filters := options.Parsers, options.Filters
+			if parsers <= 0 {
+				parsers = runtime.GOMAXPROCS(0)
+			}
+			if filters <= 0 {
+				filters = runtime.GOMAXPROCS(0)
+			}
+			c.SetStages(parsers, filters)
+		}
+		if options.SpillDir != "" {
+			if err := c.SetSpill(options.SpillDir, options.Head); err != nil {
+				return report, err
+			}
+		}
+		if options.Checkpoint != "" {
+			dir := options.Checkpoint
+			if len(crawlers) > 1 {
+				dir = filepath.Join(dir, fmt.Sprintf("node%d", i))
+			}
+			restored, err := c.SetCheckpoint(dir, options.Every)
+			if err != nil {
+				return report, err
+			}
+			report.Restored.Visited += restored.Visited
+			report.Restored.Queued += restored.Queued
+			report.Restored.Hosts += restored.Hosts
+			report.Restored.Elapsed += restored.Elapsed
+			if options.WAL > 0 {
+				c.SetWAL(options.WAL)
+			}
+		}
+		crawlers[i] = c
+	}
+	if options.Capturer != nil {
+		httpfetcher.SetProfileLabels(true)
+		crawlers[0].SetProfiler(options.Capturer, options.MinRate)
+		defer options.Capturer.Wait()
+	}
+
+	var nodes []*cluster.Node
+	if len(crawlers) > 1 {
+		if nodes, err = newCluster(crawlers, options.Exchange); err != nil {
+			return report, err
+		}
+		defer func() {
+			for _, n := range nodes {
+				n.Close()
+			}
+		}()
+	}
+
+	var sink *crawler.Sink
+	if options.Sink != "" {
+		if sink, err = crawler.NewSink(options.Sink, options.SinkIO); err != nil {
+			return report, err
+		}
+		report.Sink = sink.Backend().String()
+	}
+
+	runtime.GC()
+	var before, after runtime.MemStats
+	runtime.ReadMemStats(&before)
+	start := time.Now()
+
+	results := make(chan *crawler.Parsedresults, 64)
+	var wg sync.WaitGroup
+	for _, c := range crawlers {
+		wg.Add(1)
+		out := make(chan *crawler.Parsedresults, 64)
+		go c.Crawl(ctx, farm.Seeds(), out)
+		go func() {
+			defer wg.Done()
+			for res := range out {
+				results <- res
+			}
+		}()
+	}
+	go func() {
+		wg.Wait()
+		close(results)
+	}()
+	if nodes != nil {
+		go stopWhenQuiet(nodes, crawlers)
+	}
+
+	for res := range results {
+		report.Pages++
+		if sink != nil && err == nil {
+			err = sink.Write(res)
+		}
+		res.Release()
+	}
+	if sink != nil {
+		if cerr := sink.Close(); err == nil {
+			err = cerr
+		}
+		report.SinkBytes = sink.Bytes()
+	}
+
+	report.Elapsed = time.Since(start)
+	runtime.ReadMemStats(&after)
+
+	report.PagesPerSec = float64(report.Pages) / report.Elapsed.Seconds()
+	report.Errors = timed.errors
+	report.P50 = percentile(timed.latencies, 0.50)
+	report.P99 = percentile(timed.latencies, 0.99)
+	report.Allocs = after.Mallocs - before.Mallocs
+	report.AllocBytes = after.TotalAlloc - before.TotalAlloc
+	report.NumGC = after.NumGC - before.NumGC
+	report.GCPause = time.Duration(after.PauseTotalNs - before.PauseTotalNs)
+	report.PeakRSS = peakRSS()
+	report.Stages = stages(crawlers)
+	for _, g := range graphs {
+		report.GraphNodes += g.Nodes()
+		report.GraphBytes += g.Bytes()
+		report.GraphEvicted += g.Evicted()
+	}
+	return report, err
+}
+
+// stages averages the pipeline stage activity of the crawlers
+func stages(crawlers []*crawler.Crawler) []crawler.Stagestats {
+	var total []crawler.Stagestats
+	for _, c := range crawlers {
+		for i, s := range c.Stages() {
+			if i == len(total) {
+				total = append(total, crawler.Stagestats{Name: s.Name, Workers: s.Workers})
+			}
+			total[i].Utilization += s.Utilization / float64(len(crawlers))
+			total[i].Blocked += s.Blocked / float64(len(crawlers))
+		}
+	}
+	return total
+}
+
+// newCluster starts a node for each crawler on localhost and joins them
+func newCluster(crawlers []*crawler.Crawler, options cluster.Options) ([]*cluster.Node, error) {
+	nodes := make([]*cluster.Node, len(crawlers))
+	addrs := make([]string, len(crawlers))
+	for i, c := range crawlers {
+		n, err := cluster.NewNode("127.0.0.1:0", c, options)
+		if err != nil {
+			for _, started := range nodes[:i] {
+				started.Close()
+			}
+			return nil, err
+		}
+		nodes[i], addrs[i] = n, n.Addr()
+	}
+	for _, n := range nodes {
+		n.SetMembers(addrs)
+	}
+	return nodes, nil
+}
+
+// stopWhenQuiet stops the crawlers once every node was idle over two
+// consecutive polls with no link exchanged in between
+func stopWhenQuiet(nodes []*cluster.Node, crawlers []*crawler.Crawler) {
+	var last uint64
+	quiet := 0
+	for quiet < 2 {
+		time.Sleep(50 * time.Millisecond)
+		idle := true
+		var sent uint64
+		for _, n := range nodes {
+			idle = idle && n.Idle()
+			sent += n.Sent() + n.Dropped()
+		}
+		if idle && sent == last {
+			quiet++
+		} else {
+			quiet = 0
+		}
+		last = sent
+	}
+	for _, c := range crawlers {
+		c.Stop()
+	}
+}
+
+func percentile(samples []time.Duration, p float64) time.Duration {
+	if len(samples) == 0 {
+		return 0
+	}
+	sort.Slice(samples, func(i, j int) bool { return samples[i] < samples[j] })
+	return samples[int(p*float64(len(samples)-1))]
+}
+
+// peakRSS reads the high-water resident set size of the process
+func peakRSS() uint64 {
+	file, err := os.Open("/proc/self/status")
+	if err != nil {
+		return 0
+	}
+	defer file.Close()
+
+	scanner := bufio.NewScanner(file)
+	for scanner.Scan() {
+		if value, ok := strings.CutPrefix(scanner.Text(), "VmHWM:"); ok {
+			kb, _ := strconv.ParseUint(strings.TrimSpace(strings.TrimSuffix(value, "kB")), 10, 64)
+			return kb << 10
+		}
+	}
+	return 0
+}
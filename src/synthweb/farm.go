@@ -0,0 +1,362 @@
+package synthweb
+
+import (
+	"context"
+	"fmt"
+	"math"
+	"math/rand"
+	"net"
+	"net/http"
+	"net/http/httptest"
+	"net/netip"
+	"strconv"
+	"strings"
+	"sync/atomic"
+	"time"
+)
+
+const hostsuffix = ".synthetic"
+
+// Distribution samples the latency added to each response
+type Distribution interface {
+	Sample() time.Duration
+}
+
+// Fixed delays every response by the same amount
+type Fixed time.Duration
+
+func (d Fixed) Sample() time.Duration { return time.Duration(d) }
+
+// Uniform delays responses uniformly between Min and Max
+type Uniform struct {
+	Min, Max time.Duration
+}
+
+func (d Uniform) Sample() time.Duration {
+	if d.Max <= d.Min {
+		return d.Min
+	}
+	return d.Min + time.Duration(rand.Int63n(int64(d.Max-d.Min)))
+}
+
+// Lognormal delays responses following a log-normal distribution, which
+// models the long tail of real servers.
+type Lognormal struct {
+	Median time.Duration
+	Sigma  float64
+}
+
+func (d Lognormal) Sample() time.Duration {
+	return time.Duration(float64(d.Median) * math.Exp(d.Sigma*rand.NormFloat64()))
+}
+
+// Config describes the shape of the synthetic web
+type Config struct {
+	Hosts        int
+	PagesPerHost int
+	PageSize     int          // approximate body size of a page in bytes
+	Fanout       int          // links per page
+	External     float64      // fraction of links pointing to another host
+	Latency      Distribution // nil serves without delay
+	RobotsRate   float64      // fraction of hosts disallowing /private/
+	ErrorRate    float64      // fraction of pages answering 500
+	Flaky        float64      // fraction of requests answering 503 at random
+	Outages      float64      // fraction of hosts answering 503 to every request
+	Duplicates   float64      // fraction of pages mirroring the host root
+	Traps        float64      // fraction of hosts with an endless faceted search
+	Sitemaps     float64      // fraction of hosts listing every page in sitemaps
+	Junk         float64      // fraction of links to mailto:, javascript: or images
+	Addresses    int          // addresses the hosts resolve to, 16 per /24; one per host when zero
+	Seed         uint64
+}
+
+// DefaultConfig returns a farm of a thousand small hosts
+func DefaultConfig() Config {
+	return Config{
+		Hosts:        1000,
+		PagesPerHost: 50,
+		PageSize:     16 << 10,
+		Fanout:       20,
+		External:     0.1,
+		Latency:      Lognormal{Median: 5 * time.Millisecond, Sigma: 0.8},
+		RobotsRate:   0.3,
+		ErrorRate:    0.01,
+		Duplicates:   0.05,
+		Seed:         1,
+	}
+}
+
+// Farm is an in-process HTTP server answering for every host of a
+// synthetic web. Pages are generated deterministically from the seed.
+type Farm struct {
+	config   Config
+	words    []string
+	server   *httptest.Server
+	addr     string
+	requests atomic.Int64
+}
+
+// NewFarm starts a new Farm
+func NewFarm(config Config) *Farm {
+	f := &Farm{config: config}
+	f.words = make([]string, 1024)
+	for i := range f.words {
+		h := f.hash(-2, -2, i)
+		word := make([]byte, 3+h%6)
+		for j := range word {
+			word[j] = 'a' + byte(h>>(8+5*j)%26)
+		}
+		f.words[i] = string(word)
+	}
+	f.server = httptest.NewServer(http.HandlerFunc(f.serve))
+	f.addr = f.server.Listener.Addr().String()
+	return f
+}
+
+// NewRemoteFarm returns the Farm of config served by another process at
+// addr, so the costs of serving it stay out of the figures of a benchmark
+// crawling it
+func NewRemoteFarm(config Config, addr string) *Farm {
+	return &Farm{config: config, addr: addr}
+}
+
+// Addr returns the address the farm is served on
+func (f *Farm) Addr() string {
+	return f.addr
+}
+
+// Close shuts the farm down, if served by this process
+func (f *Farm) Close() {
+	if f.server != nil {
+		f.server.Close()
+	}
+}
+
+// Requests returns the number of requests served so far by this process
+func (f *Farm) Requests() int64 {
+	return f.requests.Load()
+}
+
+// Client returns a client that routes every host to the farm
+func (f *Farm) Client() *http.Client {
+	addr := f.addr
+	dialer := &net.Dialer{}
+	return &http.Client{
+		Transport: &http.Transport{
+			DialContext: func(ctx context.Context, network, _ string) (net.Conn, error) {
+				return dialer.DialContext(ctx, network, addr)
+			},
+			MaxIdleConns:        f.config.Hosts * 2,
+			MaxIdleConnsPerHost: 4,
+		},
+	}
+}
+
+// Host returns the name of the i-th host
+func (f *Farm) Host(i int) string {
+	return fmt.Sprintf("h%05d%s", i, hostsuffix)
+}
+
+// LookupNetIP resolves the hosts of the farm to addresses of 10.0.0.0/8,
+// shared by several hosts when Config.Addresses is below the number of
+// hosts. The farm serves every address.
+func (f *Farm) LookupNetIP(_ context.Context, _, host string) ([]netip.Addr, error) {
+	i, ok := f.hostIndex(host)
+	if !ok {
+		return nil, &net.DNSError{Err: "no such host", Name: host, IsNotFound: true}
+	}
+	if f.config.Addresses > 0 {
+		i %= f.config.Addresses
+	}
+	return []netip.Addr{netip.AddrFrom4([4]byte{10, byte(i >> 12), byte(i >> 4), byte(i&15 + 1)})}, nil
+}
+
+// Seeds returns the root page of every host
+func (f *Farm) Seeds() []string {
+	seeds := make([]string, f.config.Hosts)
+	for i := range seeds {
+		seeds[i] = "http://" + f.Host(i) + "/"
+	}
+	return seeds
+}
+
+func (f *Farm) serve(w http.ResponseWriter, r *http.Request) {
+	f.requests.Add(1)
+	if f.config.Latency != nil {
+		timer := time.NewTimer(f.config.Latency.Sample())
+		select {
+		case <-timer.C:
+		case <-r.Context().Done():
+			// The client gave up, do not hold the handler
+			timer.Stop()
+			return
+		}
+	}
+
+	host, ok := f.hostIndex(r.Host)
+	if !ok {
+		http.NotFound(w, r)
+		return
+	}
+	if f.hasOutage(host) || (f.config.Flaky > 0 && rand.Float64() < f.config.Flaky) {
+		http.Error(w, "synthetic outage", http.StatusServiceUnavailable)
+		return
+	}
+
+	if r.URL.Path == "/robots.txt" {
+		if !f.hasRobots(host) && !f.hasSitemap(host) {
+			http.NotFound(w, r)
+			return
+		}
+		w.Header().Set("Content-Type", "text/plain")
+		fmt.Fprint(w, "User-agent: *\n")
+		if f.hasRobots(host) {
+			fmt.Fprint(w, "Disallow: /private/\n")
+		}
+		if f.hasSitemap(host) {
+			fmt.Fprintf(w, "Sitemap: http://%s/sitemap_index.xml\n", f.Host(host))
+		}
+		return
+	}
+	if f.hasSitemap(host) && f.serveSitemap(w, host, r.URL.Path) {
+		return
+	}
+
+	if r.URL.Path == "/search" && f.hasTrap(host) {
+		q, _ := strconv.Atoi(r.URL.Query().Get("q"))
+		w.Header().Set("Content-Type", "text/html; charset=utf-8")
+		w.Write(f.renderSearch(host, q))
+		return
+	}
+
+	page, ok := f.pageIndex(r.URL.Path)
+	if !ok {
+		http.NotFound(w, r)
+		return
+	}
+	if f.fraction(host, page, -1) < f.config.ErrorRate {
+		http.Error(w, "synthetic failure", http.StatusInternalServerError)
+		return
+	}
+
+	if f.fraction(host, page, -2) < f.config.Duplicates {
+		// A mirror of the root under another URL
+		page = 0
+	}
+	w.Header().Set("Content-Type", "text/html; charset=utf-8")
+	w.Write(f.render(host, page))
+}
+
+func (f *Farm) render(host, page int) []byte {
+	var b strings.Builder
+	b.Grow(f.config.PageSize + f.config.Fanout*48)
+	fmt.Fprintf(&b, "<html><head><title>%s page %d</title></head><body>\n", f.Host(host), page)
+
+	for k := 0; k < f.config.Fanout; k++ {
+		h := f.hash(host, page, k)
+		target := int(h>>32) % max(f.config.PagesPerHost, 1)
+		switch {
+		case float64(h&0xffff)/(1<<16) < f.config.External:
+			other := int(h>>16&math.MaxInt16) % max(f.config.Hosts, 1)
+			fmt.Fprintf(&b, "<a href=\"http://%s/p/%d\">external</a>\n", f.Host(other), target)
+		case k == 0 && f.hasTrap(host):
+			fmt.Fprintf(&b, "<a href=\"/search?q=%d\">search</a>\n", page)
+		case float64(h>>48)/(1<<16) < f.config.Junk:
+			switch h % 3 {
+			case 0:
+				fmt.Fprintf(&b, "<a href=\"mailto:page%d@%s\">mail</a>\n", target, f.Host(host))
+			case 1:
+				fmt.Fprintf(&b, "<a href=\"javascript:show(%d)\">show</a>\n", target)
+			default:
+				fmt.Fprintf(&b, "<a href=\"/img/%d.jpg\">image</a>\n", target)
+			}
+		case k%7 == 6 && f.hasRobots(host):
+			fmt.Fprintf(&b, "<a href=\"/private/%d\">private</a>\n", target)
+		default:
+			fmt.Fprintf(&b, "<a href=\"/p/%d#top\">page %d</a>\n", target, target)
+		}
+	}
+
+	f.filler(&b, host, page)
+	return []byte(b.String())
+}
+
+// renderSearch renders a page of an endless faceted search: every result
+// page links to more queries with fresh parameter values
+func (f *Farm) renderSearch(host, q int) []byte {
+	var b strings.Builder
+	b.Grow(f.config.PageSize + f.config.Fanout*48)
+	fmt.Fprintf(&b, "<html><head><title>%s search %d</title></head><body>\n", f.Host(host), q)
+	for k := 0; k < f.config.Fanout; k++ {
+		h := f.hash(host, -4-q, k)
+		fmt.Fprintf(&b, "<a href=\"/search?q=%d&color=%d\">refine</a>\n", h>>34, h%50)
+	}
+	f.filler(&b, host, -4-q)
+	return []byte(b.String())
+}
+
+func (f *Farm) filler(b *strings.Builder, host, page int) {
+	b.WriteString("<p>")
+	for j := 0; b.Len() < f.config.PageSize; j++ {
+		b.WriteString(f.words[f.hash(host, page, -3-j)%uint64(len(f.words))])
+		b.WriteByte(' ')
+	}
+	b.WriteString("</p></body></html>\n")
+}
+
+func (f *Farm) hostIndex(host string) (int, bool) {
+	if i := strings.IndexByte(host, ':'); i >= 0 {
+		host = host[:i]
+	}
+	if !strings.HasPrefix(host, "h") || !strings.HasSuffix(host, hostsuffix) {
+		return 0, false
+	}
+	i, err := strconv.Atoi(strings.TrimSuffix(host[1:], hostsuffix))
+	if err != nil || i < 0 || i >= f.config.Hosts {
+		return 0, false
+	}
+	return i, true
+}
+
+func (f *Farm) pageIndex(path string) (int, bool) {
+	if path == "/" {
+		return 0, true
+	}
+	for _, prefix := range []string{"/p/", "/private/"} {
+		if strings.HasPrefix(path, prefix) {
+			i, err := strconv.Atoi(path[len(prefix):])
+			return i, err == nil && i >= 0 && i < f.config.PagesPerHost
+		}
+	}
+	return 0, false
+}
+
+func (f *Farm) hasTrap(host int) bool {
+	return f.fraction(host, -3, -1) < f.config.Traps
+}
+
+func (f *Farm) hasOutage(host int) bool {
+	return f.fraction(host, -4, -1) < f.config.Outages
+}
+
+func (f *Farm) hasSitemap(host int) bool {
+	return f.fraction(host, -5, -1) < f.config.Sitemaps
+}
+
+func (f *Farm) hasRobots(host int) bool {
+	return f.fraction(host, -1, -1) < f.config.RobotsRate
+}
+
+// hash mixes the seed with the host, page and link index (splitmix64)
+func (f *Farm) hash(host, page, k int) uint64 {
+	x := f.config.Seed ^ uint64(host)*0x9e3779b97f4a7c15 ^ uint64(page)<<20 ^ uint64(k)<<44
+	x ^= x >> 30
+	x *= 0xbf58476d1ce4e5b9
+	x ^= x >> 27
+	x *= 0x94d049bb133111eb
+	return x ^ x>>31
+}
+
+func (f *Farm) fraction(host, page, k int) float64 {
+	return float64(f.hash(host, page, k)>>11) / (1 << 53)
+}
@@ -0,0 +1,59 @@
+package synthweb
+
+import (
+	"compress/gzip"
+	"fmt"
+	"io"
+	"net/http"
+	"time"
+)
+
+// sitemapEpoch is the most recent lastmod of the farm. Pages were modified
+// up to a year before it.
+var sitemapEpoch = time.Date(2024, 1, 1, 0, 0, 0, 0, time.UTC)
+
+// Lastmod returns the modification time the sitemaps give for a page
+func (f *Farm) Lastmod(host, page int) time.Time {
+	days := int(f.fraction(host, page, -6) * 365)
+	return sitemapEpoch.AddDate(0, 0, -days)
+}
+
+// serveSitemap answers the sitemap index of a host and the two sitemaps it
+// lists, the second gzipped, splitting the pages between them. It reports
+// whether path was one of them.
+func (f *Farm) serveSitemap(w http.ResponseWriter, host int, path string) bool {
+	var part int
+	switch path {
+	case "/sitemap_index.xml":
+		w.Header().Set("Content-Type", "application/xml")
+		fmt.Fprint(w, `<?xml version="1.0" encoding="UTF-8"?>`+"\n"+
+			`<sitemapindex xmlns="http://www.sitemaps.org/schemas/sitemap/0.9">`+"\n")
+		fmt.Fprintf(w, "<sitemap><loc>http://%s/sitemap-1.xml</loc></sitemap>\n", f.Host(host))
+		fmt.Fprintf(w, "<sitemap><loc>http://%s/sitemap-2.xml.gz</loc></sitemap>\n", f.Host(host))
+		fmt.Fprint(w, "</sitemapindex>\n")
+		return true
+	case "/sitemap-1.xml":
+		w.Header().Set("Content-Type", "application/xml")
+		part = 0
+	case "/sitemap-2.xml.gz":
+		w.Header().Set("Content-Type", "application/x-gzip")
+		part = 1
+	default:
+		return false
+	}
+
+	var out io.Writer = w
+	if part == 1 {
+		gz := gzip.NewWriter(w)
+		defer gz.Close()
+		out = gz
+	}
+	fmt.Fprint(out, `<?xml version="1.0" encoding="UTF-8"?>`+"\n"+
+		`<urlset xmlns="http://www.sitemaps.org/schemas/sitemap/0.9">`+"\n")
+	for page := part; page < f.config.PagesPerHost; page += 2 {
+		fmt.Fprintf(out, "<url><loc>http://%s/p/%d</loc><lastmod>%s</lastmod></url>\n",
+			f.Host(host), page, f.Lastmod(host, page).Format("2006-01-02"))
+	}
+	fmt.Fprint(out, "</urlset>\n")
+	return true
+}
@@ -0,0 +1,155 @@
+package crawler
+
+import (
+	"net/url"
+	"sort"
+	"strings"
+	"sync"
+)
+
+const maxtemplates = 4096 // templates tracked per host
+
+// Traplimits bounds the URL patterns of a host. URLs beyond any limit are
+// treated as a crawler trap. A zero field disables its limit.
+type Traplimits struct {
+	PathDepth   int // path segments of an URL
+	Repeats     int // occurrences of one segment in a path
+	ParamValues int // distinct values of a query parameter per template
+	PerTemplate int // URLs admitted per template
+}
+
+// DefaultTraplimits returns limits that leave ordinary sites alone
+func DefaultTraplimits() Traplimits {
+	return Traplimits{
+		PathDepth:   16,
+		Repeats:     3,
+		ParamValues: 100,
+		PerTemplate: 2000,
+	}
+}
+
+// templatestats counts the URLs of one template
+type templatestats struct {
+	count  int
+	values map[string]map[string]struct{} // per parameter, capped at the limit
+}
+
+// trapdetector tracks URL-pattern statistics of one host. A template is the
+// path with numeric and id-like segments replaced by placeholders, followed
+// by the sorted query parameter names, so calendars and faceted searches
+// collapse into a handful of templates whose growth can be bounded.
+type trapdetector struct {
+	limits    Traplimits
+	mutex     sync.Mutex
+	templates map[string]*templatestats
+}
+
+func newTrapdetector(limits Traplimits) *trapdetector {
+	return &trapdetector{
+		limits:    limits,
+		templates: make(map[string]*templatestats),
+	}
+}
+
+// trap accounts for a new URL and reports whether it falls into a trap
+func (t *trapdetector) trap(link *url.URL) bool {
+	segments := strings.Split(strings.Trim(link.EscapedPath(), "/"), "/")
+	if t.limits.PathDepth > 0 && len(segments) > t.limits.PathDepth {
+		return true
+	}
+	if t.limits.Repeats > 0 && repeats(segments) > t.limits.Repeats {
+		return true
+	}
+
+	query := link.Query()
+	template := templateOf(segments, query)
+
+	t.mutex.Lock()
+	defer t.mutex.Unlock()
+
+	stats, ok := t.templates[template]
+	if !ok {
+		if len(t.templates) >= maxtemplates {
+			return false
+		}
+		stats = &templatestats{values: make(map[string]map[string]struct{})}
+		t.templates[template] = stats
+	}
+	if t.limits.PerTemplate > 0 && stats.count >= t.limits.PerTemplate {
+		return true
+	}
+	if t.limits.ParamValues > 0 {
+		for name, values := range query {
+			seen, ok := stats.values[name]
+			if !ok {
+				seen = make(map[string]struct{})
+				stats.values[strings.Clone(name)] = seen
+			}
+			for _, v := range values {
+				if _, ok := seen[v]; !ok {
+					if len(seen) >= t.limits.ParamValues {
+						return true
+					}
+					// The link may point into a page released after the check
+					seen[strings.Clone(v)] = struct{}{}
+				}
+			}
+		}
+	}
+	stats.count++
+	return false
+}
+
+// repeats returns the highest number of occurrences of a path segment
+func repeats(segments []string) int {
+	most := 0
+	for i, s := range segments {
+		n := 0
+		for _, other := range segments[i:] {
+			if other == s {
+				n++
+			}
+		}
+		most = max(most, n)
+	}
+	return most
+}
+
+func templateOf(segments []string, query url.Values) string {
+	var b strings.Builder
+	for _, s := range segments {
+		b.WriteByte('/')
+		b.WriteString(placeholder(s))
+	}
+	if len(query) > 0 {
+		names := make([]string, 0, len(query))
+		for name := range query {
+			names = append(names, name)
+		}
+		sort.Strings(names)
+		b.WriteByte('?')
+		b.WriteString(strings.Join(names, "&"))
+	}
+	return b.String()
+}
+
+// placeholder generalizes numeric and id-like path segments
+func placeholder(segment string) string {
+	digits, letters := 0, 0
+	for i := 0; i < len(segment); i++ {
+		c := segment[i]
+		switch {
+		case c >= '0' && c <= '9':
+			digits++
+		case (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'):
+			letters++
+		}
+	}
+	switch {
+	case digits > 0 && letters == 0:
+		return "{n}"
+	case digits > 0 && len(segment) >= 16:
+		return "{id}"
+	}
+	return segment
+}
@@ -0,0 +1,379 @@
+package crawler
+
+import (
+	"encoding/binary"
+	"fmt"
+	"hash/crc32"
+	"os"
+	"packages/src/metrics"
+	"path/filepath"
+	"slices"
+	"strconv"
+	"strings"
+	"sync"
+	"time"
+)
+
+const (
+	walbatch  = 1 << 20               // logged bytes that trigger a commit before the interval is over
+	walcommit = 10 * time.Millisecond // commit interval when none is given
+	walheld   = 1024                  // results waiting for their commit before the filter stage blocks
+	walretry  = 3                     // commits failing in a row before the log is given up
+	walmagic  = "crawlwl2"
+)
+
+var crc32c = crc32.MakeTable(crc32.Castagnoli)
+
+// Outcomes of write-ahead log commits
+const (
+	walCommitted = iota
+	walFailed
+	numWalOutcomes
+)
+
+var walOutcomes = [numWalOutcomes]string{"committed", "failed"}
+
+// SetWAL logs the changes journaled for the next checkpoint to a write-ahead
+// log under the checkpoint directory, so that a crash loses none of the
+// work done since the last checkpoint. The log is written and synced by a
+// single committer every commit interval, or sooner once a batch of records
+// is waiting, each fsync covering the records of every worker. The result
+// of a page is only sent once the log holds the page as done, so pages
+// whose results were sent are never fetched again after a restart; the
+// results committed but not sent yet when the process dies are lost. When
+// the commits keep failing the crawl stops, and the results held are only
+// sent once the last checkpoint is saved.
+//
+// The log of each checkpoint is removed once the checkpoint is saved. When
+// the checkpoint directory is opened, the logs of the checkpoints never
+// saved are replayed into deltas. A commit interval of zero or less commits
+// every 10ms. SetWAL has no effect before SetCheckpoint.
+func (c *Crawler) SetWAL(commit time.Duration) {
+	if commit <= 0 {
+		commit = walcommit
+	}
+	if c.checkpoints != nil {
+		c.checkpoints.wal = &writelog{dir: c.checkpoints.dir, commit: commit, full: make(chan struct{}, 1)}
+		c.checkpoints.wal.cond = sync.NewCond(&c.checkpoints.wal.durableMutex)
+		c.checkpoints.wal.segment = c.checkpoints.next
+	}
+}
+
+// writelog is the write-ahead log of a checkpointer. Each checkpoint has a
+// segment of its own, named after the delta it becomes. A segment is a
+// sequence of batches, one per commit, each framed by its length and CRC so
+// that a batch torn by a crash is dropped on replay.
+type writelog struct {
+	dir    string
+	commit time.Duration
+	full   chan struct{}
+
+	// Guarded by the mutex of the checkpointer
+	buffers []walbuffer // records logged but not written yet
+	segment int         // segment of the records logged from now on
+	lsn     uint64      // bytes of records logged so far
+
+	files    sync.Mutex // held while writing and removing segments
+	file     *os.File
+	fileseq  int
+	size     int64 // of file
+	synced   int64 // size of file when last synced
+	retired  int   // segments saved in a delta, and removed
+	opened   []int // segments created and not removed yet
+	failures int   // commits failed in a row
+	scratch  []byte
+
+	durableMutex sync.Mutex
+	cond         *sync.Cond
+	durable      uint64 // position up to which the records are on disk
+	closed       bool
+	broken       bool // the commits kept failing, nothing is durable anymore
+
+	commits *[numWalOutcomes]*metrics.Counter
+	sync    *metrics.Histogram
+}
+
+// walresult is a result held until the log is durable up to lsn
+type walresult struct {
+	res *Parsedresults
+	lsn uint64
+}
+
+// logging reports whether the changes are logged to a write-ahead log
+func (p *checkpointer) logging() bool {
+	return p != nil && p.wal != nil
+}
+
+// walbuffer holds the records logged for a segment, up to the position lsn
+type walbuffer struct {
+	segment int
+	records []byte
+	lsn     uint64
+}
+
+// log appends a record of kind to the log. It is called with the mutex of
+// the checkpointer held.
+func (w *writelog) log(kind int, record []byte) {
+	if len(w.buffers) == 0 || w.buffers[len(w.buffers)-1].segment != w.segment {
+		w.buffers = append(w.buffers, walbuffer{segment: w.segment})
+	}
+	b := &w.buffers[len(w.buffers)-1]
+	before := len(b.records)
+	b.records = append(b.records, byte(kind))
+	b.records = binary.AppendUvarint(b.records, uint64(len(record)))
+	b.records = append(b.records, record...)
+	w.lsn += uint64(len(b.records) - before)
+	b.lsn = w.lsn
+	if len(b.records) >= walbatch {
+		select {
+		case w.full <- struct{}{}:
+		default:
+		}
+	}
+}
+
+// run commits the log every commit interval, or as soon as a batch is
+// full, until stop is closed. It commits a last time before returning.
+func (w *writelog) run(p *checkpointer, stop <-chan struct{}) {
+	ticker := time.NewTicker(w.commit)
+	defer ticker.Stop()
+	for {
+		select {
+		case <-ticker.C:
+		case <-w.full:
+		case <-stop:
+			w.flush(p)
+			w.durableMutex.Lock()
+			w.closed = true
+			w.durableMutex.Unlock()
+			w.cond.Broadcast()
+			return
+		}
+		w.flush(p)
+	}
+}
+
+// flush writes the records logged since the last commit and syncs them.
+// When a write or sync fails, the batches not known to be on disk are cut
+// from the segment and logged again for the next commit, and the results
+// held for them stay held. After walretry failures in a row the log is
+// broken: the results are dropped rather than sent.
+func (w *writelog) flush(p *checkpointer) {
+	p.mutex.Lock()
+	buffers := w.buffers
+	w.buffers = nil
+	p.mutex.Unlock()
+	if len(buffers) == 0 {
+		return
+	}
+
+	start := time.Now()
+	w.files.Lock()
+	var err error
+	failed := len(buffers) // first batch not on disk
+	first := 0             // first batch written to the current file
+	for i, b := range buffers {
+		// Saved in a delta meanwhile
+		if b.segment <= w.retired {
+			continue
+		}
+		if w.file == nil || w.fileseq != b.segment {
+			if err = w.close(); err != nil {
+				failed = first
+				break
+			}
+			if err = w.open(b.segment); err != nil {
+				failed = i
+				break
+			}
+			first = i
+		}
+		w.scratch = binary.AppendUvarint(w.scratch[:0], uint64(len(b.records)))
+		w.scratch = binary.LittleEndian.AppendUint32(w.scratch, crc32.Checksum(b.records, crc32c))
+		w.scratch = append(w.scratch, b.records...)
+		if _, err = w.file.Write(w.scratch); err != nil {
+			failed = first
+			break
+		}
+		w.size += int64(len(w.scratch))
+	}
+	if err == nil && w.file != nil {
+		if err = w.file.Sync(); err != nil {
+			failed = first
+		}
+	}
+	if err != nil && w.file != nil {
+		// Cut the torn batches, so the next commit appends to intact ones
+		w.file.Truncate(w.synced)
+		w.size = w.synced
+	} else if w.file != nil {
+		w.synced = w.size
+	}
+	broken := false
+	if err != nil {
+		w.failures++
+		broken = w.failures >= walretry
+	} else {
+		w.failures = 0
+	}
+	w.files.Unlock()
+	w.sync.ObserveDuration(time.Since(start))
+
+	if err != nil {
+		w.commits[walFailed].Inc()
+		if !broken {
+			p.mutex.Lock()
+			w.buffers = append(buffers[failed:], w.buffers...)
+			p.mutex.Unlock()
+		}
+	} else {
+		w.commits[walCommitted].Inc()
+	}
+	if failed > 0 {
+		w.advance(buffers[failed-1].lsn)
+	}
+	if broken {
+		w.durableMutex.Lock()
+		w.broken = true
+		w.durableMutex.Unlock()
+		w.cond.Broadcast()
+	}
+}
+
+// close syncs and closes the file written, if any. It is called with files
+// held.
+func (w *writelog) close() error {
+	if w.file == nil {
+		return nil
+	}
+	if err := w.file.Sync(); err != nil {
+		return err
+	}
+	w.file.Close()
+	w.file = nil
+	return nil
+}
+
+// open makes segment the file written. It is called with files held and no
+// file open.
+func (w *writelog) open(segment int) error {
+	file, err := os.OpenFile(filepath.Join(w.dir, walName(segment)), os.O_WRONLY|os.O_CREATE|os.O_APPEND, 0o644)
+	if err != nil {
+		return err
+	}
+	info, err := file.Stat()
+	if err != nil {
+		file.Close()
+		return err
+	}
+	size := info.Size()
+	if size == 0 {
+		if _, err := file.WriteString(walmagic); err != nil {
+			file.Close()
+			return err
+		}
+		size = int64(len(walmagic))
+	}
+	w.file, w.fileseq, w.size, w.synced = file, segment, size, size
+	if !slices.Contains(w.opened, segment) {
+		w.opened = append(w.opened, segment)
+	}
+	return nil
+}
+
+// retire removes the segments up to the one of the delta just saved, whose
+// records are durable up to lsn
+func (w *writelog) retire(segment int, lsn uint64) {
+	w.files.Lock()
+	w.retired = max(w.retired, segment)
+	if w.file != nil && w.fileseq <= segment {
+		w.file.Close()
+		w.file = nil
+	}
+	w.opened = slices.DeleteFunc(w.opened, func(s int) bool {
+		if s <= segment {
+			os.Remove(filepath.Join(w.dir, walName(s)))
+			return true
+		}
+		return false
+	})
+	w.files.Unlock()
+	w.advance(lsn)
+}
+
+func (w *writelog) advance(lsn uint64) {
+	w.durableMutex.Lock()
+	if lsn > w.durable {
+		w.durable = lsn
+		w.cond.Broadcast()
+	}
+	w.durableMutex.Unlock()
+}
+
+// await blocks until the records logged up to lsn are durable, or the log
+// is closed or broken. It reports whether they are durable.
+func (w *writelog) await(lsn uint64) bool {
+	w.durableMutex.Lock()
+	defer w.durableMutex.Unlock()
+	for w.durable < lsn && !w.closed && !w.broken {
+		w.cond.Wait()
+	}
+	return w.durable >= lsn
+}
+
+func walName(segment int) string {
+	return fmt.Sprintf("wal-%08d.log", segment)
+}
+
+func walSequence(name string) (int, bool) {
+	name, ok := strings.CutPrefix(name, "wal-")
+	if !ok {
+		return 0, false
+	}
+	if name, ok = strings.CutSuffix(name, ".log"); !ok {
+		return 0, false
+	}
+	seq, err := strconv.Atoi(name)
+	return seq, err == nil
+}
+
+// replay reads the records of the intact batches of a segment, grouped by
+// kind in chunks
+func replay(path string) ([numRecords][][]byte, error) {
+	var records [numRecords][][]byte
+	data, err := os.ReadFile(path)
+	if err != nil {
+		return records, err
+	}
+	if len(data) < len(walmagic) || string(data[:len(walmagic)]) != walmagic {
+		return records, nil
+	}
+	data = data[len(walmagic):]
+	for len(data) > 0 {
+		length, n := binary.Uvarint(data)
+		if n <= 0 || len(data)-n < 4 || length > uint64(len(data)-n-4) {
+			break // torn by a crash
+		}
+		sum := binary.LittleEndian.Uint32(data[n:])
+		batch := data[n+4 : n+4+int(length)]
+		if crc32.Checksum(batch, crc32c) != sum {
+			break
+		}
+		data = data[n+4+int(length):]
+
+		r := recordreader{raw: batch}
+		for len(r.raw) > 0 && r.err == nil {
+			kind, record := int(r.flag()), r.bytes()
+			if r.err != nil || kind >= numRecords {
+				return records, errCorruptCheckpoint
+			}
+			chunks := records[kind]
+			if len(chunks) == 0 || len(chunks[len(chunks)-1]) >= checkpointchunk {
+				records[kind] = append(chunks, nil)
+			}
+			last := &records[kind][len(records[kind])-1]
+			*last = append(*last, record...)
+		}
+	}
+	return records, nil
+}
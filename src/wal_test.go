@@ -0,0 +1,119 @@
+package crawler
+
+import (
+	"encoding/binary"
+	"hash/crc32"
+	"math"
+	"net/url"
+	"os"
+	"path/filepath"
+	"testing"
+	"time"
+)
+
+// logged opens a checkpointer on dir with a write-ahead log
+func logged(t *testing.T, dir string) (*Crawler, *checkpointer) {
+	t.Helper()
+	c, _ := checkpointed(t, dir)
+	c.SetWAL(time.Hour)
+	wal := c.checkpoints.wal
+	wal.commits, wal.sync = &c.metrics.walCommits, c.metrics.walSync
+	return c, c.checkpoints
+}
+
+func TestWALReplay(t *testing.T) {
+	dir := t.TempDir()
+	_, p := logged(t, dir)
+	a, b := mustURL(t, "http://example.com/a"), mustURL(t, "http://example.com/b")
+	p.visit("http://example.com/", []string{a.String(), b.String()}, nil)
+	p.enqueueBatch([]*url.URL{a, b}, nil, 1)
+	p.complete(a)
+	p.wal.flush(p)
+	if !p.wal.await(p.position()) {
+		t.Fatal("the records flushed are not durable")
+	}
+	// The process dies without saving a checkpoint
+	p.wal.close()
+
+	c, restored := checkpointed(t, dir)
+	if restored.Visited != 2 || restored.Queued != 1 {
+		t.Errorf("restored %+v from the log, want 2 visited and 1 queued", restored)
+	}
+	if links := queuedLinks(t, c); len(links) != 1 || links[b.String()] != 1 {
+		t.Errorf("restored the entries %v, want %s", links, b)
+	}
+	if _, err := os.Stat(filepath.Join(dir, walName(1))); !os.IsNotExist(err) {
+		t.Errorf("the log replayed was not removed: %v", err)
+	}
+	if _, err := os.Stat(filepath.Join(dir, checkpointName("delta-", 1))); err != nil {
+		t.Errorf("the log replayed did not become a delta: %v", err)
+	}
+}
+
+func TestWALTornTail(t *testing.T) {
+	dir := t.TempDir()
+	_, p := logged(t, dir)
+	p.enqueue(mustURL(t, "http://example.com/first"), 1)
+	p.wal.flush(p)
+	p.enqueue(mustURL(t, "http://example.com/second"), 1)
+	p.wal.flush(p)
+	p.wal.close()
+
+	// A crash tears the second batch
+	path := filepath.Join(dir, walName(1))
+	info, err := os.Stat(path)
+	if err != nil {
+		t.Fatal(err)
+	}
+	if err := os.Truncate(path, info.Size()-3); err != nil {
+		t.Fatal(err)
+	}
+
+	c, restored := checkpointed(t, dir)
+	if links := queuedLinks(t, c); restored.Queued != 1 || len(links) != 1 || links["http://example.com/first"] != 1 {
+		t.Errorf("restored the entries %v, want the first batch alone", links)
+	}
+}
+
+func TestWALReplayCorrupt(t *testing.T) {
+	// A batch holding a single done record, as log writes it
+	done := appendURL(nil, mustURL(t, "http://example.com/a"))
+	record := binary.AppendUvarint([]byte{recordDone}, uint64(len(done)))
+	record = append(record, done...)
+	batch := func(length uint64, sum uint32, records []byte) []byte {
+		b := binary.AppendUvarint(nil, length)
+		b = binary.LittleEndian.AppendUint32(b, sum)
+		return append(b, records...)
+	}
+	intact := batch(uint64(len(record)), crc32.Checksum(record, crc32c), record)
+
+	for name, tail := range map[string][]byte{
+		"huge length":     batch(math.MaxUint64, 0, record),
+		"length past end": batch(uint64(len(record)+1), crc32.Checksum(record, crc32c), record),
+		"bad checksum":    batch(uint64(len(record)), 0, record),
+		"cut header":      {0x80},
+		"cut checksum":    binary.AppendUvarint(nil, 4),
+	} {
+		path := filepath.Join(t.TempDir(), walName(1))
+		data := append(append([]byte(walmagic), intact...), tail...)
+		if err := os.WriteFile(path, data, 0o644); err != nil {
+			t.Fatal(err)
+		}
+		records, err := replay(path)
+		if err != nil {
+			t.Errorf("%s: replay: %v", name, err)
+			continue
+		}
+		if len(records[recordDone]) != 1 || string(records[recordDone][0]) != string(done) {
+			t.Errorf("%s: replayed %q, want the intact batch alone", name, records[recordDone])
+		}
+	}
+}
+
+func TestWALDefaultCommit(t *testing.T) {
+	c, _ := checkpointed(t, t.TempDir())
+	c.SetWAL(0)
+	if c.checkpoints.wal.commit != walcommit {
+		t.Errorf("commit interval %v, want %v", c.checkpoints.wal.commit, walcommit)
+	}
+}